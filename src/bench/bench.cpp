@@ -0,0 +1,30 @@
+// count every heap allocation so the benchmarks can report allocations per iteration
+#define FAE_COUNT_ALLOCATIONS
+#include "kernel_bench.h"
+#include "math_bench.h"
+#include "scheduler_bench.h"
+
+int main()
+{
+	SetTraceLogLevel(LOG_WARNING);
+
+	bench::print_header();
+	bench::fluid_step();
+	bench::fluid_advection();
+	bench::fluid_sparse();
+	bench::fluid_recording();
+	bench::fluid_tracers();
+	bench::fluid3d_step();
+	bench::perlin_field();
+	bench::sandbox_update();
+	bench::sandbox_threads();
+	bench::sandbox_paging();
+	bench::rope_step();
+
+	std::printf("\n");
+	bench::math_kernels();
+
+	std::printf("\n");
+	scheduler_bench scheduler;
+	scheduler.run();
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include "../fae/allocations.h"
+#include <chrono>
+#include <cstdio>
+
+// Tiny benchmark harness shared by the kernel benchmarks.
+// Allocations are counted through fae::heapAllocations, bench.cpp defines FAE_COUNT_ALLOCATIONS.
+namespace bench
+{
+	struct result
+	{
+		const char* name = "";
+		// work items per iteration (grid cells, noise samples, bodies...)
+		size_t cells = 0;
+		size_t iterations = 0;
+		double nsPerIteration = 0;
+		double allocationsPerIteration = 0;
+
+		double ns_per_cell() const { return nsPerIteration / cells; }
+		double cells_per_second() const { return cells * 1e9 / nsPerIteration; }
+	};
+
+	void print_header()
+	{
+		std::printf("%-36s %10s %14s %10s %14s %12s\n", "benchmark", "iters", "ns/iter", "ns/cell", "Mcells/s", "allocs/iter");
+	}
+
+	void print(const result& r)
+	{
+		std::printf("%-36s %10zu %14.0f %10.3f %14.2f %12.1f\n",
+			r.name, r.iterations, r.nsPerIteration, r.ns_per_cell(), r.cells_per_second() / 1e6, r.allocationsPerIteration);
+	}
+
+	/// <summary>
+	/// Runs fn once to warm up, then repeatedly for at least minSeconds and minIterations, and prints the result.
+	/// </summary>
+	template<typename Fn>
+	result run(const char* name, size_t cells, Fn&& fn, double minSeconds = 0.5, size_t minIterations = 5)
+	{
+		fn();
+
+		using clock = std::chrono::steady_clock;
+		result r;
+		r.name = name;
+		r.cells = cells;
+		size_t allocationsBefore = fae::heapAllocations;
+		auto begin = clock::now();
+		double elapsed = 0;
+		while (r.iterations < minIterations || elapsed < minSeconds)
+		{
+			fn();
+			r.iterations++;
+			elapsed = std::chrono::duration<double>(clock::now() - begin).count();
+		}
+		r.nsPerIteration = elapsed * 1e9 / r.iterations;
+		r.allocationsPerIteration = double(fae::heapAllocations - allocationsBefore) / r.iterations;
+		print(r);
+		return r;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,407 @@
+#pragma once
+#include "bench.h"
+#include "fluid_legacy.h"
+#include "../fluid/fluid.h"
+#include "../fluid/fluid3d.h"
+#include "../perlin/perlin.h"
+#include "../rope/rope.h"
+#include "../sandbox/sandbox.h"
+#include <filesystem>
+#include <random>
+
+// Hot kernels of each demo, run without a window.
+namespace bench
+{
+	// seed a blob of density and a swirl so the solver has real work to do
+	template<typename Solver>
+	void seed_fluid(Solver& f, int N = 128, Vector2 velocity = { 4.f, -2.f })
+	{
+		for (int i = 0; i < 64; i++)
+		{
+			Vector2 cell = { N * 0.5f + i % 8, N * 0.5f + i / 8 };
+			f.addDensity(cell, 100.f);
+			f.addVelocity(cell, velocity);
+		}
+	}
+
+	/// <summary>
+	/// Runs fn(pool) as label over pools of 2, 4, 8... threads and of hardware_concurrency() threads, the calling thread
+	/// counting as one, and prints each speedup over single, the same work measured on the calling thread alone.
+	/// </summary>
+	template<typename Fn>
+	void thread_scaling(const char* label, size_t cells, const result& single, Fn&& fn, double minSeconds = 0.5, size_t minIterations = 5)
+	{
+		size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<size_t> threadCounts;
+		for (size_t threads = 2; threads < hardwareThreads; threads *= 2) threadCounts.push_back(threads);
+		if (hardwareThreads > 1) threadCounts.push_back(hardwareThreads);
+		for (size_t threads : threadCounts)
+		{
+			fae::thread_pool pool(threads - 1);
+			char name[64];
+			std::snprintf(name, sizeof(name), "%s %zu threads", label, threads);
+			auto r = run(name, cells, [&] { fn(&pool); }, minSeconds, minIterations);
+			std::printf("%-36s %.2fx\n", "  speedup over 1 thread", single.nsPerIteration / r.nsPerIteration);
+		}
+	}
+
+	void fluid_step()
+	{
+		legacy_fluid legacy(0, 0);
+		seed_fluid(legacy);
+		auto before = run("fluid step legacy N=128", 128 * 128, [&] { legacy.step(); });
+
+		fluid::Fluid f(0, 0);
+		seed_fluid(f);
+		auto after = run("fluid::Fluid::step N=128", 128 * 128, [&] { f.step(); });
+		std::printf("%-36s %.2fx\n", "  speedup over legacy", before.nsPerIteration / after.nsPerIteration);
+
+		// row bands over the pool
+		fluid::Fluid parallel(0, 0);
+		seed_fluid(parallel);
+		thread_scaling("fluid::Fluid::step N=128", 128 * 128, after, [&](fae::thread_pool* pool)
+		{
+			parallel.pool = pool;
+			parallel.step();
+		});
+
+		// fixed sweeps against solving to the tolerance, iterations and residual are per step
+		for (auto solver : { PressureSolver::gauss_seidel, PressureSolver::multigrid, PressureSolver::conjugate_gradient })
+		{
+			fluid::Fluid solving(0, 0);
+			solving.pressureSolver = solver;
+			seed_fluid(solving);
+			char name[64];
+			std::snprintf(name, sizeof(name), "fluid::Fluid::step %s", pressure_solver_name(solver));
+			run(name, 128 * 128, [&] { solving.step(); });
+			std::printf("  %d pressure iterations, residual %.2e\n", solving.pressureStats.iterations, solving.pressureStats.residual);
+		}
+
+		// specialized sizes against a generic one next to them, float against bfloat16 fields where memory traffic dominates
+		for (int N : { 256, 250, 512, 1024 })
+		{
+			fluid::Fluid sized(0, 0, N);
+			seed_fluid(sized, N);
+			char name[64];
+			std::snprintf(name, sizeof(name), "fluid::Fluid::step N=%d", N);
+			auto single = run(name, size_t(N) * N, [&] { sized.step(); });
+			if (N < 512) continue;
+
+			fluid::Bf16Fluid narrow(0, 0, N);
+			seed_fluid(narrow, N);
+			std::snprintf(name, sizeof(name), "fluid::Bf16Fluid::step N=%d", N);
+			auto r = run(name, size_t(N) * N, [&] { narrow.step(); });
+			std::printf("%-36s %.2fx\n", "  speedup over float", single.nsPerIteration / r.nsPerIteration);
+		}
+	}
+
+	// one advect per field against a single pass over all of them, at N=512 with dye so six fields move
+	template<typename Solver>
+	void fluid_advection_pair(const char* type)
+	{
+		constexpr int N = 512;
+		Solver f(0, 0, N);
+		f.enableDye();
+		seed_fluid(f, N);
+		f.advectScratch.resize((2 + f.maxAdvectedFields) * N);
+
+		using T = typename decltype(f.density)::value_type;
+		auto* vx = f.Vx0.data();
+		auto* vy = f.Vy0.data();
+		T* fields[] = { f.Vx.data(), f.Vy.data(), f.density.data(), f.dye[0].data(), f.dye[1].data(), f.dye[2].data() };
+		const T* previous[] = { f.Vx0.data(), f.Vy0.data(), f.s.data(), f.dye0[0].data(), f.dye0[1].data(), f.dye0[2].data() };
+		constexpr size_t fieldCount = std::size(fields);
+
+		// modeled traffic: each separate pass reads both velocities and its source and writes its field,
+		// the fused pass reads the velocities once
+		double cells = double(N) * N;
+		double separateBytes = 4 * fieldCount * cells * sizeof(T);
+		double fusedBytes = (2 + 2 * fieldCount) * cells * sizeof(T);
+
+		char name[64];
+		std::snprintf(name, sizeof(name), "advect %s x%zu N=%d", type, fieldCount, N);
+		auto separate = run(name, size_t(cells), [&]
+		{
+			for (size_t i = 0; i < fieldCount; i++) f.advect_fields({ fields + i, 1 }, { previous + i, 1 }, vx, vy);
+		});
+		std::printf("  %.1f MB modeled, %.2f GB/s\n", separateBytes / 1e6, separateBytes / separate.nsPerIteration);
+
+		std::snprintf(name, sizeof(name), "advect_fields %s x%zu N=%d", type, fieldCount, N);
+		auto fused = run(name, size_t(cells), [&] { f.advect_fields(fields, previous, vx, vy); });
+		std::printf("  %.1f MB modeled, %.2f GB/s\n", fusedBytes / 1e6, fusedBytes / fused.nsPerIteration);
+		std::printf("%-36s %.2fx\n", "  speedup over separate", separate.nsPerIteration / fused.nsPerIteration);
+
+		// and the whole step, which also diffuses and projects
+		Solver fusedStep(0, 0, N);
+		fusedStep.enableDye();
+		fusedStep.fusedAdvection = true;
+		seed_fluid(fusedStep, N);
+		std::snprintf(name, sizeof(name), "step fused advection %s N=%d", type, N);
+		auto r = run(name, size_t(cells), [&] { fusedStep.step(); });
+		Solver separateStep(0, 0, N);
+		separateStep.enableDye();
+		seed_fluid(separateStep, N);
+		std::snprintf(name, sizeof(name), "step three-pass advection %s N=%d", type, N);
+		auto baseline = run(name, size_t(cells), [&] { separateStep.step(); });
+		std::printf("%-36s %.2fx\n", "  speedup over three-pass", baseline.nsPerIteration / r.nsPerIteration);
+	}
+
+	void fluid_advection()
+	{
+		fluid_advection_pair<fluid::Fluid>("float");
+		fluid_advection_pair<fluid::Bf16Fluid>("bfloat16");
+	}
+
+	// a small slow blob in a large grid, the case sparse mode is for. The halo grows with the speed, a fast one activates most of the grid
+	void fluid_sparse()
+	{
+		for (int N : { 512, 1024 })
+		{
+			fluid::Fluid dense(0, 0, N);
+			seed_fluid(dense, N, { 0.05f, -0.025f });
+			char name[64];
+			std::snprintf(name, sizeof(name), "fluid::Fluid::step N=%d", N);
+			auto before = run(name, size_t(N) * N, [&] { dense.step(); });
+
+			fluid::Fluid sparse(0, 0, N);
+			sparse.sparse = true;
+			seed_fluid(sparse, N, { 0.05f, -0.025f });
+			std::snprintf(name, sizeof(name), "fluid::Fluid::step sparse N=%d", N);
+			auto after = run(name, size_t(N) * N, [&] { sparse.step(); });
+			std::printf("  %d of %d tiles active\n", sparse.activeTileCount, sparse.tiles * sparse.tiles);
+			std::printf("%-36s %.2fx\n", "  speedup over dense", before.nsPerIteration / after.nsPerIteration);
+		}
+	}
+
+	// bytes per frame of each encoding over the same run, and reading random frames back from the file
+	void fluid_recording()
+	{
+		constexpr int N = 128;
+		constexpr int frames = 120;
+		auto path = (std::filesystem::temp_directory_path() / "fluid_bench.rec").string();
+		double rawBytes = 0;
+		for (auto encoding : { RecordingEncoding::raw, RecordingEncoding::quantized, RecordingEncoding::delta })
+		{
+			fluid::Fluid f(0, 0, N);
+			seed_fluid(f, N);
+			std::vector<float> density, velocX, velocY;
+			uint64_t bytes;
+			{
+				FluidRecorder recorder;
+				recorder.encoding = encoding;
+				recorder.open(path, N);
+				for (int i = 0; i < frames; i++)
+				{
+					f.step();
+					f.copyDensity(density);
+					f.copyVelocity(velocX, velocY);
+					recorder.record(density, velocX, velocY);
+				}
+				recorder.close();
+				bytes = recorder.bytes_written();
+			}
+			if (encoding == RecordingEncoding::raw) rawBytes = double(bytes);
+
+			FluidReplay replay;
+			if (!replay.open(path)) continue;
+			std::mt19937 random(1);
+			char name[64];
+			std::snprintf(name, sizeof(name), "FluidReplay::read %s N=%d", recording_encoding_name(encoding), N);
+			run(name, size_t(N) * N, [&] { replay.read(random() % frames, density, velocX, velocY); });
+			std::printf("  %.1f KB a frame, %.1f%% of raw\n", bytes / 1024.0 / frames, 100.0 * bytes / rawBytes);
+		}
+		std::filesystem::remove(path);
+	}
+
+	// the cells column counts particles here, so Mcells/s is millions of particles moved a second
+	void fluid_tracers()
+	{
+		constexpr int N = 256;
+		fluid::Fluid f(0, 0, N);
+		seed_fluid(f, N);
+		for (int i = 0; i < 8; i++) f.step();
+		for (size_t count : { size_t(1) << 16, size_t(1) << 20, size_t(1) << 22 })
+		{
+			FluidTracers tracers;
+			tracers.seed(count, N);
+			char name[64];
+			std::snprintf(name, sizeof(name), "FluidTracers::advect %zuK", count >> 10);
+			auto single = run(name, count, [&] { tracers.advect(f.Vx.data(), f.Vy.data(), N, f.dt); }, 0.5, 3);
+			thread_scaling(name, count, single, [&](fae::thread_pool* pool) { tracers.advect(f.Vx.data(), f.Vy.data(), N, f.dt, pool); }, 0.5, 3);
+			std::vector<Color> pixels;
+			std::snprintf(name, sizeof(name), "FluidTracers::splat %zuK", count >> 10);
+			run(name, count, [&] { tracers.splat(pixels, 4 * N, 4 * N, 4.f); }, 0.5, 3);
+		}
+	}
+
+	void fluid3d_step()
+	{
+		for (int N : { 64, 128 })
+		{
+			fluid3d::Volume f(0, 0, N, N, N);
+			for (int i = 0; i < 64; i++)
+			{
+				Vector3 cell = { N * 0.5f + i % 4, N * 0.5f + i / 4 % 4, N * 0.5f + i / 16 };
+				f.addDensity(cell, 100.f);
+				f.addVelocity(cell, { 4.f, -2.f, 1.f });
+			}
+			char name[64];
+			std::snprintf(name, sizeof(name), "fluid3d::Volume::step N=%d", N);
+			auto single = run(name, f.cells(), [&] { f.step(); }, 0.5, 2);
+
+			// z slabs over the pool
+			thread_scaling(name, f.cells(), single, [&](fae::thread_pool* pool)
+			{
+				f.pool = pool;
+				f.step();
+			}, 0.5, 2);
+			f.pool = nullptr;
+		}
+	}
+
+	void perlin_field()
+	{
+		perlin p;
+		size_t columns = 320;
+		size_t rows = 180;
+		float offset = 0;
+		volatile float sink = 0;
+		run("perlin::noise 320x180 field", columns * rows, [&]
+		{
+			float sum = 0;
+			for (size_t i = 0; i < columns; i++)
+			{
+				for (size_t j = 0; j < rows; j++)
+				{
+					sum += p.noise(i + offset, j + offset, 0.5f);
+				}
+			}
+			offset += 0.01f;
+			sink = sum;
+		});
+	}
+
+	void sandbox_update()
+	{
+		entt::registry reg;
+		auto gridEntity = reg.create();
+		auto& grid = reg.emplace<ParticleGrid>(gridEntity);
+		grid.storage = ParticleStorage::entities;
+		auto& world = reg.emplace<ParticleWorld>(reg.create());
+
+		// fill the top half with alternating sand and water so particles keep moving
+		for (size_t y = 0; y < grid.N / 2; y++)
+		{
+			for (size_t x = 0; x < grid.N; x++)
+			{
+				auto particle = (x + y) % 3 == 0 ? water(reg) : sand(reg);
+				reg.get<ParticleTransform>(particle).position = { (float)x, (float)y };
+				auto& behavior = reg.get<ParticleBehavior>(particle);
+				behavior.grid = &grid;
+				behavior.world = &world;
+				grid.Place(particle, x, y);
+			}
+		}
+		update_grids(nullptr, reg);
+
+		auto entities = run("sandbox update_particles+update_grids", grid.N * grid.N, [&]
+		{
+			update_particles(nullptr, reg);
+			update_grids(nullptr, reg);
+		});
+
+		// the same start in cells storage
+		ParticleGrid cellGrid;
+		cellGrid.ResizeCells();
+		for (size_t y = 0; y < cellGrid.N / 2; y++)
+		{
+			for (size_t x = 0; x < cellGrid.N; x++) place_material(cellGrid, x, y, (x + y) % 3 == 0 ? ParticleMaterial::water : ParticleMaterial::sand);
+		}
+		auto cells = run("sandbox cells::update", cellGrid.N * cellGrid.N, [&] { cells::update(cellGrid); }, 0.5, 1);
+		std::printf("%-36s %.2fx\n", "  speedup over entities", entities.nsPerIteration / cells.nsPerIteration);
+
+		// once everything has come to rest the chunks sleep
+		for (int i = 0; i < 1000 && cellGrid.awakeChunks; i++) cells::update(cellGrid);
+		run("sandbox cells::update settled", cellGrid.N * cellGrid.N, [&] { cells::update(cellGrid); });
+		std::printf("  %zu of %zu chunks awake\n", cellGrid.awakeChunks, cellGrid.chunks.size());
+		std::printf("  %zu bytes a cell, entities hold %zu in components alone\n", sizeof(ParticleCell),
+			sizeof(ParticleRenderer) + sizeof(ParticleTransform) + sizeof(ParticleRigidBody) + sizeof(ParticleBehavior) + sizeof(entt::entity));
+	}
+
+	// a 1024^2 grid from the same start every iteration, so each thread count gets the same work
+	void sandbox_threads()
+	{
+		constexpr int updates = 8;
+		ParticleGrid start;
+		start.N = 1024;
+		start.ResizeCells();
+		for (size_t y = 0; y < start.N; y++)
+		{
+			for (size_t x = 0; x < start.N; x++)
+			{
+				// full, with sand over water so everything has somewhere to go
+				place_material(start, x, y, y < start.N / 2 ? ParticleMaterial::sand : (x + y) % 7 == 0 ? ParticleMaterial::empty : ParticleMaterial::water);
+			}
+		}
+
+		ParticleGrid grid;
+		auto updateFromStart = [&](fae::thread_pool* pool, bool deterministic)
+		{
+			grid = start;
+			grid.pool = pool;
+			grid.deterministic = deterministic;
+			for (int i = 0; i < updates; i++) cells::update(grid);
+		};
+		size_t cells = start.N * start.N * updates;
+		run("sandbox cells 1024^2 serial", cells, [&] { updateFromStart(nullptr, false); }, 0.5, 2);
+		auto single = run("sandbox cells 1024^2 checkerboard", cells, [&] { updateFromStart(nullptr, true); }, 0.5, 2);
+		thread_scaling("sandbox cells 1024^2", cells, single, [&](fae::thread_pool* pool) { updateFromStart(pool, true); }, 0.5, 2);
+	}
+
+	// a 16384^2 world with a camera going round a circle, pouring sand as it goes so the chunks it leaves have cells to write.
+	// The cells column is the active chunks' cells
+	void sandbox_paging()
+	{
+		ParticleGrid grid;
+		grid.N = 16384;
+		ParticlePager pager;
+		pager.activeRadius = 4;
+		pager.maxResidentChunks = 256;
+		if (!pager.open(grid)) return;
+
+		constexpr int lap = 2048;
+		int frame = 0;
+		auto step = [&]
+		{
+			float angle = frame++ * 6.2831853f / lap;
+			int x = int(grid.N / 2 + grid.N / 4 * std::cos(angle));
+			int y = int(grid.N / 2 + grid.N / 4 * std::sin(angle));
+			pager.stream(grid, x, y);
+			for (int i = 0; i < 16; i++) place_material(grid, x + i, y - ParticleChunk::size, ParticleMaterial::sand);
+			cells::update(grid);
+		};
+		// the first lap only pages in empty chunks, time the ones after it
+		for (int i = 0; i < lap; i++) step();
+		pager.stats = {};
+		size_t activeCells = grid.activeChunks.size() * ParticleChunk::size * ParticleChunk::size;
+		run("sandbox paged 16384^2 stream+update", activeCells, step, 0.5, lap);
+
+		auto& stats = pager.stats;
+		std::printf("  %.1f%% hits, page in avg %.3f ms max %.3f ms, page out avg %.3f ms max %.3f ms\n",
+			stats.HitRate() * 100, stats.AvgPageInMs(), stats.maxPageInMs, stats.AvgPageOutMs(), stats.maxPageOutMs);
+		std::printf("  %.1f MB of pages and %.1f MB in the region file for a %.1f MB world\n", grid.pages.size() * sizeof(ParticleChunk::Cells) / 1048576.0,
+			pager.region_bytes() / 1048576.0, double(grid.N) * grid.N * sizeof(ParticleCell) / 1048576.0);
+		pager.close();
+	}
+
+	void rope_step()
+	{
+		entt::registry reg;
+		rope_simulation app;
+		auto& physics = reg.ctx().emplace<rope_simulation::Physics>();
+		app.setup_rope_grid(app, reg);
+		app.setup_rope_joints(app, reg);
+
+		run("b2World::Step rope grid", physics.world.GetBodyCount(), [&] { physics.world.Step(1.f / 60.f, 6, 2); });
+	}
+}
\ No newline at end of file
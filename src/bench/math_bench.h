@@ -0,0 +1,46 @@
+#pragma once
+#include "bench.h"
+#include "../fae/fae.h"
+#include <cstdio>
+#include <vector>
+
+// Batched fae::math kernels at every simd level the cpu supports.
+namespace bench
+{
+	void math_kernels()
+	{
+		int width = 1024;
+		int height = 1024;
+		size_t count = (size_t)width * height;
+		std::vector<float> a(count), b(count), out(count), xs(count), ys(count), field(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			a[i] = (i % 97) * 0.5f;
+			b[i] = (i % 89) * 0.25f;
+			field[i] = (i % 101) * 0.01f;
+			// positions a fraction of a cell away from each cell, like advection backtraces
+			xs[i] = (i % width) + ((i * 7) % 13) * 0.1f - 0.6f;
+			ys[i] = (i / width) + ((i * 5) % 11) * 0.1f - 0.5f;
+		}
+
+		auto detected = fae::math::simd;
+		for (int level = 0; level <= (int)detected; level++)
+		{
+			fae::math::simd = (fae::math::simd_level)level;
+			auto levelName = fae::math::simd_level_name(fae::math::simd);
+			char name[64];
+
+			std::snprintf(name, sizeof(name), "math::lerp %s", levelName);
+			run(name, count, [&] { fae::math::lerp(a, b, 0.5f, out); });
+			std::snprintf(name, sizeof(name), "math::add %s", levelName);
+			run(name, count, [&] { fae::math::add(a, b, out); });
+			std::snprintf(name, sizeof(name), "math::scale %s", levelName);
+			run(name, count, [&] { fae::math::scale(a, 1.5f, out); });
+			std::snprintf(name, sizeof(name), "math::clamp %s", levelName);
+			run(name, count, [&] { fae::math::clamp(a, 4.f, 16.f, out); });
+			std::snprintf(name, sizeof(name), "math::bilinear_sample %s", levelName);
+			run(name, count, [&] { fae::math::bilinear_sample(field, width, height, xs, ys, out); });
+		}
+		fae::math::simd = detected;
+	}
+}
\ No newline at end of file
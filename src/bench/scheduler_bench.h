@@ -0,0 +1,69 @@
+#pragma once
+#include "../fae/fae.h"
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
+// Per-frame dispatch overhead of the scheduler with a few hundred empty systems,
+// compared against rebuilding the organizer graph and preparing every node each frame.
+struct scheduler_bench
+{
+	template<size_t I>
+	struct Resource {};
+
+	// no arguments, so the only dependency is the resource requested when emplacing
+	template<size_t I>
+	static void read_write() {}
+
+	size_t systemCount = 512;
+	size_t frames = 2000;
+
+	template<size_t... I>
+	void emplace_systems(fae::phase& phase, entt::organizer& organizer, std::index_sequence<I...>)
+	{
+		// a handful of distinct resources so the parallel plan has something to schedule
+		for (size_t i = 0; i < systemCount; i += sizeof...(I))
+		{
+			(phase.emplace<&read_write<I>, Resource<I>>(), ...);
+			(organizer.emplace<&read_write<I>, Resource<I>>(), ...);
+		}
+	}
+
+	template<typename Fn>
+	double measure(Fn&& fn)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < frames; i++) fn();
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(end - begin).count() / frames;
+	}
+
+	void run()
+	{
+		entt::registry reg;
+		fae::phase phase;
+		entt::organizer organizer;
+		emplace_systems(phase, organizer, std::make_index_sequence<8>{});
+
+		double rebuilt = measure([&]
+		{
+			for (auto&& node : organizer.graph())
+			{
+				node.prepare(reg);
+				node.callback()(node.data(), reg);
+			}
+		});
+
+		fae::scheduler scheduler;
+		scheduler.compile(phase, reg);
+		double cached = measure([&] { scheduler.run(phase, reg); });
+
+		scheduler.mode = fae::scheduler::execution_mode::parallel;
+		double parallel = measure([&] { scheduler.run(phase, reg); });
+
+		std::printf("scheduler overhead, %zu systems, %zu frames\n", phase.size(), frames);
+		std::printf("  rebuild graph every frame : %10.0f ns/frame %8.1f ns/system\n", rebuilt, rebuilt / phase.size());
+		std::printf("  cached plan (serial)      : %10.0f ns/frame %8.1f ns/system\n", cached, cached / phase.size());
+		std::printf("  cached plan (parallel)    : %10.0f ns/frame %8.1f ns/system\n", parallel, parallel / phase.size());
+	}
+};
\ No newline at end of file
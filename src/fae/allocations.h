@@ -0,0 +1,30 @@
+#pragma once
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace fae
+{
+	// define FAE_COUNT_ALLOCATIONS before including fae to count every global operator new call
+	// (it replaces operator new/delete, so only one translation unit may do it)
+#ifdef FAE_COUNT_ALLOCATIONS
+	constexpr bool countingAllocations = true;
+#else
+	constexpr bool countingAllocations = false;
+#endif
+
+	// total heap allocations so far, stays 0 unless FAE_COUNT_ALLOCATIONS is defined
+	inline std::atomic<size_t> heapAllocations = 0;
+}
+
+#ifdef FAE_COUNT_ALLOCATIONS
+void* operator new(size_t size)
+{
+	fae::heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+#endif
\ No newline at end of file
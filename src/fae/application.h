@@ -1,92 +1,75 @@
 #pragma once
 #include "fae.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 namespace fae
 {
 	struct application
 	{
 		struct systems
 		{
-			entt::organizer preStart;
-			entt::organizer start;
-			entt::organizer postStart;
+			fae::phase preStart{ "preStart" };
+			fae::phase start{ "start" };
+			fae::phase postStart{ "postStart" };
 
-			entt::organizer preUpdate;
-			entt::organizer update_controlled_gameobject;
-			entt::organizer postUpdate;
+			fae::phase preUpdate{ "preUpdate" };
+			// stepped at FixedTimestep::dt, zero or more times per frame or on its own thread
+			fae::phase fixedUpdate{ "fixedUpdate" };
+			fae::phase update_controlled_gameobject{ "update_controlled_gameobject" };
+			fae::phase postUpdate{ "postUpdate" };
 
-			entt::organizer preStop;
-			entt::organizer stop;
-			entt::organizer postStop;
+			// skipped when running headless
+			fae::phase preRender{ "preRender" };
+			fae::phase render{ "render" };
+			fae::phase postRender{ "postRender" };
+
+			fae::phase preStop{ "preStop" };
+			fae::phase stop{ "stop" };
+			fae::phase postStop{ "postStop" };
 		};
 
 		bool isRunning = false;
 		entt::registry registry;
-		entt::organizer plugins;
+		fae::phase plugins{ "plugins" };
 		systems systems;
+		fae::scheduler scheduler;
 
 		application& start()
 		{
 			isRunning = true;
 			registry.ctx().emplace<application&>(*this);
-			for (auto&& node : plugins.graph())
-			{
-				node.prepare(registry);
-				node.callback()(NULL, registry);
-			}
-			for (auto&& node : systems.preStart.graph())
-			{
-				node.prepare(registry);
-				node.callback()(NULL, registry);
-			}
-			for (auto&& node : systems.start.graph())
-			{
-				node.prepare(registry);
-				node.callback()(NULL, registry);
-			}
-			for (auto&& node : systems.postStart.graph())
-			{
-				node.prepare(registry);
-				node.callback()(NULL, registry);
-			}
+			registry.ctx().emplace<FrameArena>();
+			scheduler.run(plugins, registry);
+			scheduler.run(systems.preStart, registry);
+			scheduler.run(systems.start, registry);
+			scheduler.run(systems.postStart, registry);
+			start_fixed_update();
 			return *this;
 		}
 		application& update_controlled_gameobject()
 		{
-			for (auto&& node : systems.preUpdate.graph())
-			{
-				node.prepare(registry);
-				node.callback()(NULL, registry);
-			}
-			for (auto&& node : systems.update_controlled_gameobject.graph())
+			scheduler.run(systems.preUpdate, registry);
+			run_fixed_update();
+			scheduler.run(systems.update_controlled_gameobject, registry);
+			scheduler.run(systems.postUpdate, registry);
+			if (!is_headless(registry))
 			{
-				node.prepare(registry);
-				node.callback()(NULL, registry);
-			}
-			for (auto&& node : systems.postUpdate.graph())
-			{
-				node.prepare(registry);
-				node.callback()(NULL, registry);
+				scheduler.run(systems.preRender, registry);
+				scheduler.run(systems.render, registry);
+				scheduler.run(systems.postRender, registry);
 			}
+			registry.ctx().at<FrameArena>().Reset();
 			return *this;
 		}
 		application& stop()
 		{
 			isRunning = false;
-			for (auto&& node : systems.preStop.graph())
-			{
-				node.prepare(registry);
-				node.callback()(NULL, registry);
-			}
-			for (auto&& node : systems.stop.graph())
-			{
-				node.prepare(registry);
-				node.callback()(NULL, registry);
-			}
-			for (auto&& node : systems.postStop.graph())
-			{
-				node.prepare(registry);
-				node.callback()(NULL, registry);
-			}
+			stop_fixed_update();
+			scheduler.run(systems.preStop, registry);
+			scheduler.run(systems.stop, registry);
+			scheduler.run(systems.postStop, registry);
 			return *this;
 		}
 
@@ -100,5 +83,69 @@ namespace fae
 			stop();
 			return *this;
 		}
+
+	private:
+		std::thread simulationThread;
+		std::atomic<bool> simulating = false;
+
+		void start_fixed_update()
+		{
+			auto& fixed = registry.ctx().emplace<FixedTimestep>();
+			// compiled here so the simulation thread never prepares pools or emplaces into the context
+			scheduler.compile(systems.fixedUpdate, registry);
+			if (!fixed.threaded || is_headless(registry) || systems.fixedUpdate.size() == 0) return;
+
+			if (scheduler.mode == fae::scheduler::execution_mode::parallel) scheduler.pool();
+			simulating = true;
+			simulationThread = std::thread([this] { run_simulation_thread(); });
+		}
+
+		void run_fixed_update()
+		{
+			auto& fixed = registry.ctx().at<FixedTimestep>();
+			if (simulationThread.joinable())
+			{
+				fixed.accumulator = 0;
+				return;
+			}
+
+			size_t steps = 0;
+			while (fixed.accumulator >= fixed.dt && steps < fixed.maxStepsPerFrame)
+			{
+				scheduler.run(systems.fixedUpdate, registry);
+				fixed.accumulator -= fixed.dt;
+				fixed.step++;
+				steps++;
+			}
+			// whatever couldn't be caught up is dropped instead of piling onto the next frame
+			fixed.accumulator = std::min<double>(fixed.accumulator, fixed.dt);
+			fixed.alpha = fixed.accumulator / fixed.dt;
+		}
+
+		// simulation thread loop, steps at its own rate while the main thread keeps updating and drawing
+		void run_simulation_thread()
+		{
+			using clock = std::chrono::steady_clock;
+			auto& fixed = registry.ctx().at<FixedTimestep>();
+			auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(fixed.dt));
+			auto next = clock::now();
+			while (simulating)
+			{
+				scheduler.run(systems.fixedUpdate, registry);
+				fixed.step++;
+
+				next += period;
+				auto now = clock::now();
+				if (now - next > period * fixed.maxStepsPerFrame) next = now;
+				std::this_thread::sleep_until(next);
+			}
+		}
+
+		void stop_fixed_update()
+		{
+			if (!simulationThread.joinable()) return;
+			simulating = false;
+			simulationThread.join();
+		}
 	};
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 #include "fae.h"
+#include <algorithm>
+#include <cmath>
 namespace fae
 {
 	struct ActiveCamera2D
@@ -7,9 +9,115 @@ namespace fae
 		Camera2D* camera = nullptr;
 	};
 
+	/// <summary>
+	/// Emplace into the context to pan the active camera by dragging with panButton and zoom around the cursor with the wheel.
+	/// </summary>
+	struct Camera2DController
+	{
+		int panButton = MOUSE_BUTTON_MIDDLE;
+		float zoomStep = 0.125f;
+		float minZoom = 0.25f;
+		float maxZoom = 16.f;
+	};
+
+	/// <summary>
+	/// World-space rectangle seen through the active camera this frame (the whole window when there is no camera).
+	/// Renderers use it to skip whatever is off screen.
+	/// </summary>
+	struct VisibleRegion
+	{
+		Rectangle world = { 0, 0, 0, 0 };
+
+		bool Overlaps(Rectangle rectangle) const { return CheckCollisionRecs(world, rectangle); }
+
+		bool Contains(Vector2 point, float radius = 0) const
+		{
+			return point.x + radius >= world.x && point.x - radius <= world.x + world.width
+				&& point.y + radius >= world.y && point.y - radius <= world.y + world.height;
+		}
+
+		// cells of a columns x rows grid of square cells starting at origin that are at least partly visible
+		CellRange Cells(Vector2 origin, float cellSize, int columns, int rows) const
+		{
+			CellRange range;
+			range.xBegin = std::clamp((int)std::floor((world.x - origin.x) / cellSize), 0, columns);
+			range.yBegin = std::clamp((int)std::floor((world.y - origin.y) / cellSize), 0, rows);
+			range.xEnd = std::clamp((int)std::ceil((world.x + world.width - origin.x) / cellSize), 0, columns);
+			range.yEnd = std::clamp((int)std::ceil((world.y + world.height - origin.y) / cellSize), 0, rows);
+			return range;
+		}
+	};
+
+	// visible cells of a grid, every cell when nothing publishes a visible region
+	CellRange visible_cells(const entt::registry& reg, Vector2 origin, float cellSize, int columns, int rows)
+	{
+		if (auto region = reg.ctx().find<VisibleRegion>()) return region->Cells(origin, cellSize, columns, rows);
+		return { 0, 0, columns, rows };
+	}
+
+	// screen position to world position through the active camera, unchanged without one
+	Vector2 screen_to_world(const entt::registry& reg, Vector2 position)
+	{
+		auto active = reg.ctx().find<ActiveCamera2D>();
+		if (!active || !active->camera) return position;
+		return GetScreenToWorld2D(position, *active->camera);
+	}
+
 	void setup_camera2d(const void*, entt::registry& reg)
 	{
 		reg.ctx().emplace<ActiveCamera2D>();
+		reg.ctx().emplace<VisibleRegion>();
+	}
+
+	void control_active_camera2d(const void*, entt::registry& reg)
+	{
+		auto controller = reg.ctx().find<Camera2DController>();
+		auto input = reg.ctx().find<Input>();
+		auto& active = reg.ctx().at<ActiveCamera2D>();
+		if (!controller || !input || !active.camera) return;
+
+		auto& camera = *active.camera;
+		if (input->IsMouseButtonDown(controller->panButton))
+		{
+			camera.target = Vector2Subtract(camera.target, Vector2Scale(input->mouseDelta, 1.f / camera.zoom));
+		}
+		if (input->mouseWheel != 0)
+		{
+			// zoom around the cursor, keeping the world point under it in place
+			camera.target = GetScreenToWorld2D(input->mousePosition, camera);
+			camera.offset = input->mousePosition;
+			camera.zoom = Clamp(camera.zoom * (1 + input->mouseWheel * controller->zoomStep), controller->minZoom, controller->maxZoom);
+		}
+	}
+
+	// runs in preUpdate so update systems filling grids already see this frame's region, works headless too
+	void update_visible_region(const void*, entt::registry& reg)
+	{
+		WindowDescriptor window;
+		if (auto descriptor = reg.ctx().find<WindowDescriptor>()) window = *descriptor;
+		auto& region = reg.ctx().at<VisibleRegion>();
+		auto& active = reg.ctx().at<ActiveCamera2D>();
+		if (!active.camera)
+		{
+			region.world = { 0, 0, (float)window.width, (float)window.height };
+			return;
+		}
+
+		// bounds of all four corners, the camera may be rotated
+		Vector2 corners[] = {
+			GetScreenToWorld2D({ 0, 0 }, *active.camera),
+			GetScreenToWorld2D({ (float)window.width, 0 }, *active.camera),
+			GetScreenToWorld2D({ 0, (float)window.height }, *active.camera),
+			GetScreenToWorld2D({ (float)window.width, (float)window.height }, *active.camera),
+		};
+		Vector2 min = corners[0];
+		Vector2 max = corners[0];
+		for (auto& corner : corners)
+		{
+			min = { std::min(min.x, corner.x), std::min(min.y, corner.y) };
+			max = { std::max(max.x, corner.x), std::max(max.y, corner.y) };
+		}
+		region.world = { min.x, min.y, max.x - min.x, max.y - min.y };
 	}
 
 	void begin_active_camera2d(const void*, entt::registry& reg)
@@ -24,11 +132,14 @@ namespace fae
 		EndMode2D();
 	}
 
+	// emplace after the input plugin and before plugins drawing in screen space, like the profiler
 	void camera2d_plugin(const void*, entt::registry& reg)
 	{
 		auto& app = reg.ctx().at<application&>();
 		app.systems.preStart.emplace(setup_camera2d);
-		app.systems.preUpdate.emplace(begin_active_camera2d);
-		app.systems.postUpdate.emplace(end_camera2d);
+		app.systems.preUpdate.emplace(control_active_camera2d);
+		app.systems.preUpdate.emplace(update_visible_region);
+		app.systems.preRender.emplace(begin_active_camera2d);
+		app.systems.postRender.emplace(end_camera2d);
 	}
 }
\ No newline at end of file
@@ -4,8 +4,19 @@
 #include <rlgl.h>
 #include <raymath.h>
 
+#include "allocations.h"
+#include "frame_arena.h"
+#include "thread_pool.h"
+#include "triple_buffer.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "headless.h"
+#include "fixed_timestep.h"
 #include "application.h"
 #include "rendering.h"
+#include "time.h"
+#include "input.h"
 #include "camera2d.h"
+#include "profiler_plugin.h"
 
 #include "math.h"
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+
+namespace fae
+{
+	/// <summary>
+	/// Emplace into the context to change how the fixedUpdate phase is stepped.
+	/// Simulation systems go in fixedUpdate and read dt from here instead of Time, so they advance
+	/// by the same amount every step no matter how long frames take.
+	/// </summary>
+	struct FixedTimestep
+	{
+		float dt = 1.f / 60.f;
+		// upper bound on steps per frame, so a slow frame can't make the next one slower
+		size_t maxStepsPerFrame = 8;
+		// runs fixedUpdate on its own thread at its own rate instead of inside the frame. Ignored when headless.
+		// Systems in fixedUpdate then must only touch state they own and hand results over through a triple_buffer.
+		bool threaded = false;
+
+		// frame time not simulated yet, fed by update_time
+		double accumulator = 0;
+		// how far between the last step and the next one the current frame is, for interpolating when drawing
+		float alpha = 0;
+		// number of steps run so far, only written by whichever thread runs fixedUpdate
+		size_t step = 0;
+	};
+}
\ No newline at end of file
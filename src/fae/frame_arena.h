@@ -0,0 +1,104 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace fae
+{
+	/// <summary>
+	/// Bump allocator for data that only lives until the end of the frame, available as a context resource.
+	/// Hand it to pmr containers (std::pmr::vector<T> values(&arena)) instead of allocating temporaries on the heap.
+	/// Deallocating is a no-op, everything is released at once when the application resets it at the end of the frame.
+	/// When a frame needed more than one block, the blocks are merged into a single one on reset,
+	/// so after a few frames of warm up the arena stops allocating altogether.
+	/// Don't use it from fixedUpdate on the simulation thread, the reset doesn't wait for it.
+	/// </summary>
+	struct FrameArena : public std::pmr::memory_resource
+	{
+		explicit FrameArena(size_t initialCapacity = 64 * 1024)
+		{
+			AddBlock(initialCapacity);
+		}
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		void Reset()
+		{
+			std::scoped_lock lock(mutex);
+			if (blocks.size() > 1)
+			{
+				size_t capacity = 0;
+				for (auto& block : blocks) capacity += block.size;
+				blocks.clear();
+				AddBlock(capacity);
+			}
+			offset = 0;
+			peak = std::max(peak, used);
+			used = 0;
+		}
+
+		// bytes handed out since the last reset
+		size_t Used() const { return used; }
+		// most bytes handed out in a single frame so far
+		size_t Peak() const { return std::max(peak, used); }
+		size_t Capacity() const
+		{
+			size_t capacity = 0;
+			for (auto& block : blocks) capacity += block.size;
+			return capacity;
+		}
+
+	private:
+		struct block
+		{
+			std::unique_ptr<std::byte[]> data;
+			size_t size = 0;
+		};
+
+		std::vector<block> blocks;
+		// into the last block
+		size_t offset = 0;
+		size_t used = 0;
+		size_t peak = 0;
+		// systems in the same phase may run on different workers
+		std::mutex mutex;
+
+		void AddBlock(size_t size)
+		{
+			blocks.push_back({ std::make_unique<std::byte[]>(size), size });
+			offset = 0;
+		}
+
+		// carves bytes out of the end of the last block, null when they don't fit
+		void* Bump(size_t bytes, size_t alignment)
+		{
+			auto& current = blocks.back();
+			void* p = current.data.get() + offset;
+			size_t space = current.size - offset;
+			if (!std::align(alignment, bytes, p, space)) return nullptr;
+			offset = current.size - space + bytes;
+			return p;
+		}
+
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			std::scoped_lock lock(mutex);
+			void* p = Bump(bytes, alignment);
+			if (!p)
+			{
+				AddBlock(std::max(blocks.back().size * 2, bytes + alignment));
+				p = Bump(bytes, alignment);
+			}
+			used += bytes;
+			return p;
+		}
+
+		void do_deallocate(void*, size_t, size_t) override {}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+	};
+}
\ No newline at end of file
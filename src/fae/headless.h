@@ -0,0 +1,61 @@
+#pragma once
+#include "fae.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+
+namespace fae
+{
+	struct Input;
+
+	/// <summary>
+	/// Emplace into the context before running to skip the window entirely: no rendering phases,
+	/// a fixed timestep, a fixed number of frames and input coming from a script instead of raylib.
+	/// </summary>
+	struct HeadlessDescriptor
+	{
+		size_t frames = 600;
+		float dt = 1.f / 60.f;
+		// frames left out of the steady-state heap allocation count reported at the end
+		size_t warmupFrames = 60;
+		// called every frame with the 1-based frame number, sets the input state for that frame
+		std::function<void(size_t frame, Input& input)> script;
+		// demos drawing through a PixelGrid write their last frame here when set
+		std::string snapshotPath;
+	};
+
+	struct HeadlessStats
+	{
+		std::chrono::steady_clock::time_point begin;
+		size_t frames = 0;
+		double seconds = 0;
+		// fae::heapAllocations after the warm up frames and after the last frame
+		size_t allocationsAfterWarmup = 0;
+		size_t allocationsAtEnd = 0;
+	};
+
+	bool is_headless(const entt::registry& reg)
+	{
+		return reg.ctx().contains<HeadlessDescriptor>();
+	}
+
+	/// <summary>
+	/// Reads --headless [--frames N] [--dt seconds] [--snapshot file.png] from the command line. Returns whether headless mode was requested.
+	/// </summary>
+	bool configure_headless(entt::registry& reg, int argc, char** argv)
+	{
+		bool headless = false;
+		HeadlessDescriptor descriptor;
+		for (int i = 1; i < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--headless") == 0) headless = true;
+			else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) descriptor.frames = std::strtoull(argv[++i], nullptr, 10);
+			else if (std::strcmp(argv[i], "--dt") == 0 && i + 1 < argc) descriptor.dt = std::strtof(argv[++i], nullptr);
+			else if (std::strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) descriptor.snapshotPath = argv[++i];
+		}
+		if (headless) reg.ctx().emplace<HeadlessDescriptor>(std::move(descriptor));
+		return headless;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+#include "fae.h"
+#include <bitset>
+
+namespace fae
+{
+	/// <summary>
+	/// Input state for the current frame. Polled from raylib when there is a window, filled by the headless script otherwise.
+	/// </summary>
+	struct Input
+	{
+		Vector2 mousePosition = { 0, 0 };
+		Vector2 mouseDelta = { 0, 0 };
+		float mouseWheel = 0;
+		std::bitset<8> mouseDown;
+		std::bitset<8> mousePressed;
+		std::bitset<8> mouseReleased;
+		std::bitset<512> keysDown;
+		std::bitset<512> keysPressed;
+		std::bitset<512> keysReleased;
+
+		bool IsMouseButtonDown(int button) const { return mouseDown[button]; }
+		bool IsMouseButtonPressed(int button) const { return mousePressed[button]; }
+		bool IsMouseButtonReleased(int button) const { return mouseReleased[button]; }
+		bool IsKeyDown(int key) const { return keysDown[key]; }
+		bool IsKeyPressed(int key) const { return keysPressed[key]; }
+		bool IsKeyReleased(int key) const { return keysReleased[key]; }
+	};
+
+	void setup_input(const void*, entt::registry& reg)
+	{
+		reg.ctx().emplace<Input>();
+	}
+
+	void update_input(const void*, entt::registry& reg)
+	{
+		auto& input = reg.ctx().at<Input>();
+		auto previousMousePosition = input.mousePosition;
+		auto previousMouseDown = input.mouseDown;
+		auto previousKeysDown = input.keysDown;
+
+		if (auto headless = reg.ctx().find<HeadlessDescriptor>())
+		{
+			input.mouseWheel = 0;
+			if (headless->script) headless->script(reg.ctx().at<Time>().frame, input);
+		}
+		else
+		{
+			input.mousePosition = GetMousePosition();
+			input.mouseWheel = GetMouseWheelMove();
+			for (int button = 0; button < (int)input.mouseDown.size(); button++)
+			{
+				input.mouseDown[button] = ::IsMouseButtonDown(button);
+			}
+			for (int key = 0; key < (int)input.keysDown.size(); key++)
+			{
+				input.keysDown[key] = ::IsKeyDown(key);
+			}
+		}
+
+		input.mouseDelta = { input.mousePosition.x - previousMousePosition.x, input.mousePosition.y - previousMousePosition.y };
+		input.mousePressed = input.mouseDown & ~previousMouseDown;
+		input.mouseReleased = ~input.mouseDown & previousMouseDown;
+		input.keysPressed = input.keysDown & ~previousKeysDown;
+		input.keysReleased = ~input.keysDown & previousKeysDown;
+	}
+
+	// moves the os cursor too when there is a window
+	void set_mouse_position(entt::registry& reg, Vector2 position)
+	{
+		reg.ctx().at<Input>().mousePosition = position;
+		if (!is_headless(reg)) SetMousePosition(position.x, position.y);
+	}
+
+	// needs time_plugin for the frame number handed to headless scripts
+	void input_plugin(const void*, entt::registry& reg)
+	{
+		auto& app = reg.ctx().at<application&>();
+		app.systems.preStart.emplace(setup_input);
+		app.systems.preUpdate.emplace(update_input);
+	}
+}
\ No newline at end of file
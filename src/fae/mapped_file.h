@@ -0,0 +1,157 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+// keep windows.h from declaring what raylib declares too (Rectangle, CloseWindow, DrawText...) and from defining min and max
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef NOGDI
+#define NOGDI
+#endif
+#ifndef NOUSER
+#define NOUSER
+#endif
+#include <windows.h>
+#undef near
+#undef far
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fae
+{
+	/// <summary>
+	/// Memory map of a whole file, read-only from open or read-write from create. Pages are read in by the OS as they're
+	/// touched, so opening a large file costs nothing until its bytes are used. Move-only, unmapped on destruction.
+	/// </summary>
+	struct mapped_file
+	{
+		mapped_file() = default;
+		explicit mapped_file(const std::string& path) { open(path); }
+		~mapped_file() { close(); }
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+		mapped_file(mapped_file&& other) noexcept { *this = std::move(other); }
+		mapped_file& operator=(mapped_file&& other) noexcept
+		{
+			if (this == &other) return *this;
+			close();
+			bytes = std::exchange(other.bytes, nullptr);
+			length = std::exchange(other.length, 0);
+			writable = std::exchange(other.writable, false);
+#ifdef _WIN32
+			file = std::exchange(other.file, INVALID_HANDLE_VALUE);
+			mapping = std::exchange(other.mapping, nullptr);
+#endif
+			return *this;
+		}
+
+		// false when the file can't be opened or is empty
+		bool open(const std::string& path)
+		{
+			close();
+#ifdef _WIN32
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) return false;
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) { close(); return false; }
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!mapping) { close(); return false; }
+			bytes = (const std::byte*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (!bytes) { close(); return false; }
+			length = (size_t)fileSize.QuadPart;
+#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) return false;
+			struct stat info;
+			if (fstat(fd, &info) != 0 || info.st_size == 0)
+			{
+				::close(fd);
+				return false;
+			}
+			void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			// the mapping keeps the file alive on its own
+			::close(fd);
+			if (view == MAP_FAILED) return false;
+			bytes = (const std::byte*)view;
+			length = (size_t)info.st_size;
+#endif
+			return true;
+		}
+
+		// read-write map of the first size bytes of path, created when missing and grown to size when shorter.
+		// Writes through writable_data() reach the file, the OS writes them back as it sees fit
+		bool create(const std::string& path, size_t size)
+		{
+			close();
+			if (size == 0) return false;
+#ifdef _WIN32
+			file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) return false;
+			// a mapping larger than the file grows it
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, DWORD((uint64_t)size >> 32), DWORD(size & 0xffffffffu), nullptr);
+			if (!mapping) { close(); return false; }
+			bytes = (const std::byte*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+			if (!bytes) { close(); return false; }
+#else
+			int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+			if (fd < 0) return false;
+			struct stat info;
+			if (fstat(fd, &info) != 0 || ((size_t)info.st_size < size && ftruncate(fd, (off_t)size) != 0))
+			{
+				::close(fd);
+				return false;
+			}
+			void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd);
+			if (view == MAP_FAILED) return false;
+			bytes = (const std::byte*)view;
+#endif
+			length = size;
+			writable = true;
+			return true;
+		}
+
+		void close()
+		{
+#ifdef _WIN32
+			if (bytes) UnmapViewOfFile(bytes);
+			if (mapping) CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+			mapping = nullptr;
+			file = INVALID_HANDLE_VALUE;
+#else
+			if (bytes) munmap((void*)bytes, length);
+#endif
+			bytes = nullptr;
+			length = 0;
+			writable = false;
+		}
+
+		bool is_open() const { return bytes != nullptr; }
+		const std::byte* data() const { return bytes; }
+		// null unless the map came from create
+		std::byte* writable_data() const { return writable ? (std::byte*)bytes : nullptr; }
+		size_t size() const { return length; }
+
+	private:
+		const std::byte* bytes = nullptr;
+		size_t length = 0;
+		bool writable = false;
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#endif
+	};
+}
\ No newline at end of file
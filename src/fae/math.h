@@ -1,9 +1,596 @@
 #pragma once
 #include <raylib.h>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FAE_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define FAE_X86 0
+#endif
+
+// MSVC lets any function use any instruction set, GCC and Clang need each function marked
+#if defined(__GNUC__) || defined(__clang__)
+#define FAE_TARGET_SSE __attribute__((target("sse2")))
+#define FAE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FAE_TARGET_SSE
+#define FAE_TARGET_AVX2
+#endif
 
 namespace fae::math
 {
 	float lerp(float a, float b, float x) { return a + x * (b - a); }
 	Vector2 lerp(Vector2 a, Vector2 b, float t) { return { lerp(a.x, b.x, t), lerp(a.y, b.y, t) }; }
 	Vector3 lerp(Vector3 a, Vector3 b, float t) { return { lerp(a.x, b.x, t), lerp(a.y, b.y, t), lerp(a.z, b.z, t) }; }
+
+	enum class simd_level
+	{
+		scalar,
+		sse,
+		avx2,
+	};
+
+	const char* simd_level_name(simd_level level)
+	{
+		switch (level)
+		{
+		case simd_level::avx2: return "avx2";
+		case simd_level::sse: return "sse";
+		default: return "scalar";
+		}
+	}
+
+	simd_level detect_simd_level()
+	{
+#if FAE_X86
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return simd_level::sse;
+		__cpuid(info, 1);
+		bool osUsesXsave = info[2] & (1 << 27);
+		bool avx = info[2] & (1 << 28);
+		__cpuidex(info, 7, 0);
+		bool avx2 = info[1] & (1 << 5);
+		// the OS also has to save the ymm registers on context switches
+		if (osUsesXsave && avx && avx2 && (_xgetbv(0) & 0b110) == 0b110) return simd_level::avx2;
+		return simd_level::sse;
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return simd_level::avx2;
+		if (__builtin_cpu_supports("sse2")) return simd_level::sse;
+		return simd_level::scalar;
+#endif
+#else
+		return simd_level::scalar;
+#endif
+	}
+
+	// picked from cpuid at startup, lower it to compare implementations
+	inline simd_level simd = detect_simd_level();
+
+	/// <summary>
+	/// Flushes denormal inputs and results to zero on the current thread while alive, and restores the previous mode after.
+	/// Fields that decay towards zero fill up with denormals, which x86 handles in microcode at many times the cost.
+	/// </summary>
+	struct flush_denormals
+	{
+#if FAE_X86
+		// flush to zero and denormals are zero
+		static constexpr unsigned int modeBits = 0x8040;
+		unsigned int previous = _mm_getcsr();
+
+		flush_denormals() { _mm_setcsr(previous | modeBits); }
+		~flush_denormals() { _mm_setcsr(previous); }
+#else
+		flush_denormals() = default;
+#endif
+		flush_denormals(const flush_denormals&) = delete;
+		flush_denormals& operator=(const flush_denormals&) = delete;
+	};
+
+	/// <summary>
+	/// Storage-only 16-bit float: the top half of a float, so same range with 8 bits of precision.
+	/// Converting is a shift, values are widened to float for any arithmetic.
+	/// </summary>
+	struct bfloat16
+	{
+		uint16_t bits = 0;
+	};
+
+	float to_float(float value) { return value; }
+	float to_float(bfloat16 value) { return std::bit_cast<float>(uint32_t(value.bits) << 16); }
+
+	// rounds to nearest, ties to even
+	bfloat16 to_bfloat16(float value)
+	{
+		uint32_t bits = std::bit_cast<uint32_t>(value);
+		bits += 0x7fff + ((bits >> 16) & 1);
+		return { uint16_t(bits >> 16) };
+	}
+
+	// to_float the other way, for code templated on the storage type
+	template<typename T>
+	T from_float(float value)
+	{
+		if constexpr (std::is_same_v<T, bfloat16>) return to_bfloat16(value);
+		else return value;
+	}
+
+	namespace detail
+	{
+		void lerp_scalar(const float* a, const float* b, float t, float* out, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++) out[i] = a[i] + t * (b[i] - a[i]);
+		}
+
+		void add_scalar(const float* a, const float* b, float* out, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++) out[i] = a[i] + b[i];
+		}
+
+		void add_scalar(const float* a, float b, float* out, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++) out[i] = a[i] + b;
+		}
+
+		void scale_scalar(const float* a, float s, float* out, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++) out[i] = a[i] * s;
+		}
+
+		void clamp_scalar(const float* a, float low, float high, float* out, size_t begin, size_t end)
+		{
+			// the bound first, so NaN comes out as low the way max_ps with the bound second does
+			for (size_t i = begin; i < end; i++) out[i] = std::min(std::max(low, a[i]), high);
+		}
+
+		void widen_scalar(const bfloat16* a, float* out, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++) out[i] = to_float(a[i]);
+		}
+
+		void narrow_scalar(const float* a, bfloat16* out, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++) out[i] = to_bfloat16(a[i]);
+		}
+
+		// the bilinear kernels sample fieldCount fields at the same positions, working out corners and weights once per position
+		template<typename T>
+		void bilinear_scalar(const T* const* fields, float* const* outs, size_t fieldCount, int width, int height, const float* xs, const float* ys, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				float x = std::min(std::max(0.f, xs[i]), width - 1.f);
+				float y = std::min(std::max(0.f, ys[i]), height - 1.f);
+				int i0 = (int)x;
+				int j0 = (int)y;
+				int i1 = std::min(i0 + 1, width - 1);
+				int j1 = std::min(j0 + 1, height - 1);
+				float s1 = x - i0;
+				float s0 = 1.f - s1;
+				float t1 = y - j0;
+				float t0 = 1.f - t1;
+				for (size_t f = 0; f < fieldCount; f++)
+				{
+					const T* field = fields[f];
+					outs[f][i] = s0 * (t0 * to_float(field[i0 + j0 * width]) + t1 * to_float(field[i0 + j1 * width]))
+						+ s1 * (t0 * to_float(field[i1 + j0 * width]) + t1 * to_float(field[i1 + j1 * width]));
+				}
+			}
+		}
+
+#if FAE_X86
+		FAE_TARGET_SSE void lerp_sse(const float* a, const float* b, float t, float* out, size_t count)
+		{
+			size_t i = 0;
+			__m128 vt = _mm_set1_ps(t);
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 va = _mm_loadu_ps(a + i);
+				__m128 vb = _mm_loadu_ps(b + i);
+				_mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(vt, _mm_sub_ps(vb, va))));
+			}
+			lerp_scalar(a, b, t, out, i, count);
+		}
+
+		FAE_TARGET_AVX2 void lerp_avx2(const float* a, const float* b, float t, float* out, size_t count)
+		{
+			size_t i = 0;
+			__m256 vt = _mm256_set1_ps(t);
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256 va = _mm256_loadu_ps(a + i);
+				__m256 vb = _mm256_loadu_ps(b + i);
+				_mm256_storeu_ps(out + i, _mm256_add_ps(va, _mm256_mul_ps(vt, _mm256_sub_ps(vb, va))));
+			}
+			lerp_scalar(a, b, t, out, i, count);
+		}
+
+		FAE_TARGET_SSE void add_sse(const float* a, const float* b, float* out, size_t count)
+		{
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4) _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+			add_scalar(a, b, out, i, count);
+		}
+
+		FAE_TARGET_AVX2 void add_avx2(const float* a, const float* b, float* out, size_t count)
+		{
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8) _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+			add_scalar(a, b, out, i, count);
+		}
+
+		FAE_TARGET_SSE void add_sse(const float* a, float b, float* out, size_t count)
+		{
+			size_t i = 0;
+			__m128 vb = _mm_set1_ps(b);
+			for (; i + 4 <= count; i += 4) _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(a + i), vb));
+			add_scalar(a, b, out, i, count);
+		}
+
+		FAE_TARGET_AVX2 void add_avx2(const float* a, float b, float* out, size_t count)
+		{
+			size_t i = 0;
+			__m256 vb = _mm256_set1_ps(b);
+			for (; i + 8 <= count; i += 8) _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(a + i), vb));
+			add_scalar(a, b, out, i, count);
+		}
+
+		FAE_TARGET_SSE void scale_sse(const float* a, float s, float* out, size_t count)
+		{
+			size_t i = 0;
+			__m128 vs = _mm_set1_ps(s);
+			for (; i + 4 <= count; i += 4) _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(a + i), vs));
+			scale_scalar(a, s, out, i, count);
+		}
+
+		FAE_TARGET_AVX2 void scale_avx2(const float* a, float s, float* out, size_t count)
+		{
+			size_t i = 0;
+			__m256 vs = _mm256_set1_ps(s);
+			for (; i + 8 <= count; i += 8) _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), vs));
+			scale_scalar(a, s, out, i, count);
+		}
+
+		FAE_TARGET_SSE void clamp_sse(const float* a, float low, float high, float* out, size_t count)
+		{
+			size_t i = 0;
+			__m128 vlow = _mm_set1_ps(low);
+			__m128 vhigh = _mm_set1_ps(high);
+			for (; i + 4 <= count; i += 4) _mm_storeu_ps(out + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(a + i), vlow), vhigh));
+			clamp_scalar(a, low, high, out, i, count);
+		}
+
+		FAE_TARGET_AVX2 void clamp_avx2(const float* a, float low, float high, float* out, size_t count)
+		{
+			size_t i = 0;
+			__m256 vlow = _mm256_set1_ps(low);
+			__m256 vhigh = _mm256_set1_ps(high);
+			for (; i + 8 <= count; i += 8) _mm256_storeu_ps(out + i, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(a + i), vlow), vhigh));
+			clamp_scalar(a, low, high, out, i, count);
+		}
+
+		FAE_TARGET_SSE void widen_sse(const bfloat16* a, float* out, size_t count)
+		{
+			size_t i = 0;
+			__m128i zero = _mm_setzero_si128();
+			for (; i + 8 <= count; i += 8)
+			{
+				// interleaving zeros below each value puts it in the top half of a 32-bit lane
+				__m128i bits = _mm_loadu_si128((const __m128i*)(a + i));
+				_mm_storeu_ps(out + i, _mm_castsi128_ps(_mm_unpacklo_epi16(zero, bits)));
+				_mm_storeu_ps(out + i + 4, _mm_castsi128_ps(_mm_unpackhi_epi16(zero, bits)));
+			}
+			widen_scalar(a, out, i, count);
+		}
+
+		FAE_TARGET_AVX2 void widen_avx2(const bfloat16* a, float* out, size_t count)
+		{
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256i bits = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(a + i)));
+				_mm256_storeu_ps(out + i, _mm256_castsi256_ps(_mm256_slli_epi32(bits, 16)));
+			}
+			widen_scalar(a, out, i, count);
+		}
+
+		// same rounding as to_bfloat16, the top halves are shifted down and packed
+		FAE_TARGET_SSE void narrow_sse(const float* a, bfloat16* out, size_t count)
+		{
+			size_t i = 0;
+			__m128i bias = _mm_set1_epi32(0x7fff);
+			__m128i one = _mm_set1_epi32(1);
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128i bits = _mm_castps_si128(_mm_loadu_ps(a + i));
+				__m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 16), one);
+				__m128i rounded = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, bias), odd), 16);
+				// sse2 only packs signed, shuffling the low halves together avoids saturating
+				rounded = _mm_shufflelo_epi16(rounded, _MM_SHUFFLE(3, 1, 2, 0));
+				rounded = _mm_shufflehi_epi16(rounded, _MM_SHUFFLE(3, 1, 2, 0));
+				_mm_storel_epi64((__m128i*)(out + i), _mm_shuffle_epi32(rounded, _MM_SHUFFLE(3, 1, 2, 0)));
+			}
+			narrow_scalar(a, out, i, count);
+		}
+
+		FAE_TARGET_AVX2 void narrow_avx2(const float* a, bfloat16* out, size_t count)
+		{
+			size_t i = 0;
+			__m256i bias = _mm256_set1_epi32(0x7fff);
+			__m256i one = _mm256_set1_epi32(1);
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256i bits = _mm256_castps_si256(_mm256_loadu_ps(a + i));
+				__m256i odd = _mm256_and_si256(_mm256_srli_epi32(bits, 16), one);
+				__m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(bits, bias), odd), 16);
+				// values fit in 16 bits unsigned, so the unsigned pack doesn't saturate. It works per 128-bit half, the permute joins them
+				__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(rounded, rounded), _MM_SHUFFLE(3, 1, 2, 0));
+				_mm_storeu_si128((__m128i*)(out + i), _mm256_castsi256_si128(packed));
+			}
+			narrow_scalar(a, out, i, count);
+		}
+
+		// sse has no gather, the four corners are loaded one lane at a time and blended with vector math
+		template<typename T>
+		FAE_TARGET_SSE void bilinear_sse(const T* const* fields, float* const* outs, size_t fieldCount, int width, int height, const float* xs, const float* ys, size_t count)
+		{
+			size_t i = 0;
+			__m128 maxX = _mm_set1_ps(width - 1.f);
+			__m128 maxY = _mm_set1_ps(height - 1.f);
+			__m128 zero = _mm_setzero_ps();
+			__m128 one = _mm_set1_ps(1.f);
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(xs + i), zero), maxX);
+				__m128 y = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(ys + i), zero), maxY);
+				// coordinates are clamped non-negative, so truncating is flooring
+				__m128i i0 = _mm_cvttps_epi32(x);
+				__m128i j0 = _mm_cvttps_epi32(y);
+				__m128 s1 = _mm_sub_ps(x, _mm_cvtepi32_ps(i0));
+				__m128 t1 = _mm_sub_ps(y, _mm_cvtepi32_ps(j0));
+				__m128 s0 = _mm_sub_ps(one, s1);
+				__m128 t0 = _mm_sub_ps(one, t1);
+
+				alignas(16) int i0s[4], j0s[4];
+				_mm_store_si128((__m128i*)i0s, i0);
+				_mm_store_si128((__m128i*)j0s, j0);
+				int c00[4], c01[4], c10[4], c11[4];
+				for (int lane = 0; lane < 4; lane++)
+				{
+					int i1 = std::min(i0s[lane] + 1, width - 1);
+					int j1 = std::min(j0s[lane] + 1, height - 1);
+					c00[lane] = i0s[lane] + j0s[lane] * width;
+					c01[lane] = i0s[lane] + j1 * width;
+					c10[lane] = i1 + j0s[lane] * width;
+					c11[lane] = i1 + j1 * width;
+				}
+				for (size_t f = 0; f < fieldCount; f++)
+				{
+					const T* field = fields[f];
+					alignas(16) float d00[4], d01[4], d10[4], d11[4];
+					for (int lane = 0; lane < 4; lane++)
+					{
+						d00[lane] = to_float(field[c00[lane]]);
+						d01[lane] = to_float(field[c01[lane]]);
+						d10[lane] = to_float(field[c10[lane]]);
+						d11[lane] = to_float(field[c11[lane]]);
+					}
+					__m128 left = _mm_add_ps(_mm_mul_ps(t0, _mm_load_ps(d00)), _mm_mul_ps(t1, _mm_load_ps(d01)));
+					__m128 right = _mm_add_ps(_mm_mul_ps(t0, _mm_load_ps(d10)), _mm_mul_ps(t1, _mm_load_ps(d11)));
+					_mm_storeu_ps(outs[f] + i, _mm_add_ps(_mm_mul_ps(s0, left), _mm_mul_ps(s1, right)));
+				}
+			}
+			bilinear_scalar(fields, outs, fieldCount, width, height, xs, ys, i, count);
+		}
+
+		FAE_TARGET_AVX2 void bilinear_avx2(const float* const* fields, float* const* outs, size_t fieldCount, int width, int height, const float* xs, const float* ys, size_t count)
+		{
+			size_t i = 0;
+			__m256 maxX = _mm256_set1_ps(width - 1.f);
+			__m256 maxY = _mm256_set1_ps(height - 1.f);
+			__m256 zero = _mm256_setzero_ps();
+			__m256 one = _mm256_set1_ps(1.f);
+			__m256i lastColumn = _mm256_set1_epi32(width - 1);
+			__m256i lastRow = _mm256_set1_epi32(height - 1);
+			__m256i stride = _mm256_set1_epi32(width);
+			__m256i step = _mm256_set1_epi32(1);
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(xs + i), zero), maxX);
+				__m256 y = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(ys + i), zero), maxY);
+				__m256i i0 = _mm256_cvttps_epi32(x);
+				__m256i j0 = _mm256_cvttps_epi32(y);
+				__m256i i1 = _mm256_min_epi32(_mm256_add_epi32(i0, step), lastColumn);
+				__m256i j1 = _mm256_min_epi32(_mm256_add_epi32(j0, step), lastRow);
+				__m256 s1 = _mm256_sub_ps(x, _mm256_cvtepi32_ps(i0));
+				__m256 t1 = _mm256_sub_ps(y, _mm256_cvtepi32_ps(j0));
+				__m256 s0 = _mm256_sub_ps(one, s1);
+				__m256 t0 = _mm256_sub_ps(one, t1);
+
+				__m256i row0 = _mm256_mullo_epi32(j0, stride);
+				__m256i row1 = _mm256_mullo_epi32(j1, stride);
+				__m256i c00 = _mm256_add_epi32(i0, row0);
+				__m256i c01 = _mm256_add_epi32(i0, row1);
+				__m256i c10 = _mm256_add_epi32(i1, row0);
+				__m256i c11 = _mm256_add_epi32(i1, row1);
+				for (size_t f = 0; f < fieldCount; f++)
+				{
+					const float* field = fields[f];
+					__m256 d00 = _mm256_i32gather_ps(field, c00, 4);
+					__m256 d01 = _mm256_i32gather_ps(field, c01, 4);
+					__m256 d10 = _mm256_i32gather_ps(field, c10, 4);
+					__m256 d11 = _mm256_i32gather_ps(field, c11, 4);
+					__m256 left = _mm256_add_ps(_mm256_mul_ps(t0, d00), _mm256_mul_ps(t1, d01));
+					__m256 right = _mm256_add_ps(_mm256_mul_ps(t0, d10), _mm256_mul_ps(t1, d11));
+					_mm256_storeu_ps(outs[f] + i, _mm256_add_ps(_mm256_mul_ps(s0, left), _mm256_mul_ps(s1, right)));
+				}
+			}
+			bilinear_scalar(fields, outs, fieldCount, width, height, xs, ys, i, count);
+		}
+
+		// 16-bit gathers don't exist, each 32-bit gather fetches a corner and its right neighbor at once. Where the right
+		// neighbor would be clamped to the last column the pair starts one cell left instead with all the weight on the right,
+		// which comes out the same as the scalar version
+		FAE_TARGET_AVX2 void bilinear_avx2(const bfloat16* const* fields, float* const* outs, size_t fieldCount, int width, int height, const float* xs, const float* ys, size_t count)
+		{
+			if (width < 2) return bilinear_scalar(fields, outs, fieldCount, width, height, xs, ys, 0, count);
+			size_t i = 0;
+			__m256 maxX = _mm256_set1_ps(width - 1.f);
+			__m256 maxY = _mm256_set1_ps(height - 1.f);
+			__m256 zero = _mm256_setzero_ps();
+			__m256 one = _mm256_set1_ps(1.f);
+			__m256i lastPair = _mm256_set1_epi32(width - 2);
+			__m256i lastRow = _mm256_set1_epi32(height - 1);
+			__m256i stride = _mm256_set1_epi32(width);
+			__m256i step = _mm256_set1_epi32(1);
+			__m256i lowHalf = _mm256_set1_epi32(0xffff);
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(xs + i), zero), maxX);
+				__m256 y = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(ys + i), zero), maxY);
+				__m256i i0 = _mm256_min_epi32(_mm256_cvttps_epi32(x), lastPair);
+				__m256i j0 = _mm256_cvttps_epi32(y);
+				__m256i j1 = _mm256_min_epi32(_mm256_add_epi32(j0, step), lastRow);
+				__m256 s1 = _mm256_sub_ps(x, _mm256_cvtepi32_ps(i0));
+				__m256 t1 = _mm256_sub_ps(y, _mm256_cvtepi32_ps(j0));
+				__m256 s0 = _mm256_sub_ps(one, s1);
+				__m256 t0 = _mm256_sub_ps(one, t1);
+
+				__m256i c0 = _mm256_add_epi32(i0, _mm256_mullo_epi32(j0, stride));
+				__m256i c1 = _mm256_add_epi32(i0, _mm256_mullo_epi32(j1, stride));
+				for (size_t f = 0; f < fieldCount; f++)
+				{
+					// scale 2 turns cell indices into byte offsets of 16-bit cells
+					const int* pairs = (const int*)fields[f];
+					__m256i pair0 = _mm256_i32gather_epi32(pairs, c0, 2);
+					__m256i pair1 = _mm256_i32gather_epi32(pairs, c1, 2);
+					__m256 d00 = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(pair0, lowHalf), 16));
+					__m256 d10 = _mm256_castsi256_ps(_mm256_andnot_si256(lowHalf, pair0));
+					__m256 d01 = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(pair1, lowHalf), 16));
+					__m256 d11 = _mm256_castsi256_ps(_mm256_andnot_si256(lowHalf, pair1));
+					__m256 left = _mm256_add_ps(_mm256_mul_ps(t0, d00), _mm256_mul_ps(t1, d01));
+					__m256 right = _mm256_add_ps(_mm256_mul_ps(t0, d10), _mm256_mul_ps(t1, d11));
+					_mm256_storeu_ps(outs[f] + i, _mm256_add_ps(_mm256_mul_ps(s0, left), _mm256_mul_ps(s1, right)));
+				}
+			}
+			bilinear_scalar(fields, outs, fieldCount, width, height, xs, ys, i, count);
+		}
+#endif
+	}
+
+	// Batched kernels over structure-of-arrays buffers. Each processes out.size() elements, inputs must be at least
+	// that long and may alias out. All three implementations do the same operations in the same order, so they agree bit for bit.
+
+	// out[i] = a[i] + t * (b[i] - a[i])
+	void lerp(std::span<const float> a, std::span<const float> b, float t, std::span<float> out)
+	{
+#if FAE_X86
+		if (simd == simd_level::avx2) return detail::lerp_avx2(a.data(), b.data(), t, out.data(), out.size());
+		if (simd == simd_level::sse) return detail::lerp_sse(a.data(), b.data(), t, out.data(), out.size());
+#endif
+		detail::lerp_scalar(a.data(), b.data(), t, out.data(), 0, out.size());
+	}
+
+	void add(std::span<const float> a, std::span<const float> b, std::span<float> out)
+	{
+#if FAE_X86
+		if (simd == simd_level::avx2) return detail::add_avx2(a.data(), b.data(), out.data(), out.size());
+		if (simd == simd_level::sse) return detail::add_sse(a.data(), b.data(), out.data(), out.size());
+#endif
+		detail::add_scalar(a.data(), b.data(), out.data(), 0, out.size());
+	}
+
+	void add(std::span<const float> a, float b, std::span<float> out)
+	{
+#if FAE_X86
+		if (simd == simd_level::avx2) return detail::add_avx2(a.data(), b, out.data(), out.size());
+		if (simd == simd_level::sse) return detail::add_sse(a.data(), b, out.data(), out.size());
+#endif
+		detail::add_scalar(a.data(), b, out.data(), 0, out.size());
+	}
+
+	void scale(std::span<const float> a, float s, std::span<float> out)
+	{
+#if FAE_X86
+		if (simd == simd_level::avx2) return detail::scale_avx2(a.data(), s, out.data(), out.size());
+		if (simd == simd_level::sse) return detail::scale_sse(a.data(), s, out.data(), out.size());
+#endif
+		detail::scale_scalar(a.data(), s, out.data(), 0, out.size());
+	}
+
+	void clamp(std::span<const float> a, float low, float high, std::span<float> out)
+	{
+#if FAE_X86
+		if (simd == simd_level::avx2) return detail::clamp_avx2(a.data(), low, high, out.data(), out.size());
+		if (simd == simd_level::sse) return detail::clamp_sse(a.data(), low, high, out.data(), out.size());
+#endif
+		detail::clamp_scalar(a.data(), low, high, out.data(), 0, out.size());
+	}
+
+	void widen(std::span<const bfloat16> a, std::span<float> out)
+	{
+#if FAE_X86
+		if (simd == simd_level::avx2) return detail::widen_avx2(a.data(), out.data(), out.size());
+		if (simd == simd_level::sse) return detail::widen_sse(a.data(), out.data(), out.size());
+#endif
+		detail::widen_scalar(a.data(), out.data(), 0, out.size());
+	}
+
+	void narrow(std::span<const float> a, std::span<bfloat16> out)
+	{
+#if FAE_X86
+		if (simd == simd_level::avx2) return detail::narrow_avx2(a.data(), out.data(), out.size());
+		if (simd == simd_level::sse) return detail::narrow_sse(a.data(), out.data(), out.size());
+#endif
+		detail::narrow_scalar(a.data(), out.data(), 0, out.size());
+	}
+
+	/// <summary>
+	/// Samples several row-major width x height fields at (xs[i], ys[i]) in cell units with bilinear filtering, outs[f] gets xs.size()
+	/// samples of fields[f]. Positions are clamped to the fields, so edge cells repeat outwards.
+	/// Corners and weights are worked out once per position for all the fields, results match sampling them one by one.
+	/// </summary>
+	void bilinear_sample(std::span<const float* const> fields, int width, int height, std::span<const float> xs, std::span<const float> ys, std::span<float* const> outs)
+	{
+#if FAE_X86
+		if (simd == simd_level::avx2) return detail::bilinear_avx2(fields.data(), outs.data(), fields.size(), width, height, xs.data(), ys.data(), xs.size());
+		if (simd == simd_level::sse) return detail::bilinear_sse(fields.data(), outs.data(), fields.size(), width, height, xs.data(), ys.data(), xs.size());
+#endif
+		detail::bilinear_scalar(fields.data(), outs.data(), fields.size(), width, height, xs.data(), ys.data(), 0, xs.size());
+	}
+
+	void bilinear_sample(std::span<const bfloat16* const> fields, int width, int height, std::span<const float> xs, std::span<const float> ys, std::span<float* const> outs)
+	{
+#if FAE_X86
+		if (simd == simd_level::avx2) return detail::bilinear_avx2(fields.data(), outs.data(), fields.size(), width, height, xs.data(), ys.data(), xs.size());
+		if (simd == simd_level::sse) return detail::bilinear_sse(fields.data(), outs.data(), fields.size(), width, height, xs.data(), ys.data(), xs.size());
+#endif
+		detail::bilinear_scalar(fields.data(), outs.data(), fields.size(), width, height, xs.data(), ys.data(), 0, xs.size());
+	}
+
+	// one field
+	void bilinear_sample(std::span<const float> field, int width, int height, std::span<const float> xs, std::span<const float> ys, std::span<float> out)
+	{
+		const float* fields[] = { field.data() };
+		float* outs[] = { out.data() };
+		bilinear_sample(fields, width, height, xs.first(out.size()), ys.first(out.size()), outs);
+	}
+
+	// same for a bfloat16 field, widened as it's sampled
+	void bilinear_sample(std::span<const bfloat16> field, int width, int height, std::span<const float> xs, std::span<const float> ys, std::span<float> out)
+	{
+		const bfloat16* fields[] = { field.data() };
+		float* outs[] = { out.data() };
+		bilinear_sample(fields, width, height, xs.first(out.size()), ys.first(out.size()), outs);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#pragma once
+#include "fae.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fae
+{
+	/// <summary>
+	/// Times every scheduled system (and any profile_zone) by name. Keeps rolling stats per name
+	/// and, when tracePath is set, writes a Chrome trace_event file on stop (open it in chrome://tracing or Perfetto).
+	/// </summary>
+	struct Profiler
+	{
+		using clock = std::chrono::steady_clock;
+
+		struct Stats
+		{
+			static constexpr size_t window = 240;
+			// durations in milliseconds of the last window samples
+			std::vector<float> samples;
+			size_t next = 0;
+			size_t count = 0;
+
+			void push(float ms)
+			{
+				if (samples.size() < window) samples.push_back(ms);
+				else samples[next] = ms;
+				next = (next + 1) % window;
+				count++;
+			}
+
+			float min() const { return samples.empty() ? 0.f : *std::min_element(samples.begin(), samples.end()); }
+
+			float avg() const
+			{
+				if (samples.empty()) return 0.f;
+				float sum = 0;
+				for (auto sample : samples) sum += sample;
+				return sum / samples.size();
+			}
+
+			float p99() const
+			{
+				if (samples.empty()) return 0.f;
+				auto sorted = samples;
+				auto index = std::min(sorted.size() - 1, sorted.size() * 99 / 100);
+				std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+				return sorted[index];
+			}
+		};
+
+		struct TraceEvent
+		{
+			const std::string* name;
+			double begin;
+			double duration;
+			size_t thread;
+		};
+
+		bool enabled = true;
+		bool drawOverlay = false;
+		int overlayToggleKey = KEY_F3;
+		size_t overlayRows = 12;
+		// no trace is written when empty
+		std::string tracePath;
+		size_t maxTraceEvents = 1 << 20;
+
+		clock::time_point origin = clock::now();
+		std::map<std::string, Stats, std::less<>> stats;
+		std::vector<TraceEvent> trace;
+
+		void record(std::string_view name, clock::time_point begin, clock::time_point end, size_t thread)
+		{
+			std::scoped_lock lock(mutex);
+			auto it = stats.find(name);
+			if (it == stats.end()) it = stats.emplace(std::string(name), Stats{}).first;
+			it->second.push(std::chrono::duration<float, std::milli>(end - begin).count());
+
+			if (tracePath.empty() || trace.size() >= maxTraceEvents) return;
+			trace.push_back({
+				&it->first,
+				std::chrono::duration<double, std::micro>(begin - origin).count(),
+				std::chrono::duration<double, std::micro>(end - begin).count(),
+				thread });
+		}
+
+		// held while reading stats from outside record
+		std::unique_lock<std::mutex> lock() { return std::unique_lock(mutex); }
+
+		bool write_trace(const std::string& path) const
+		{
+			auto file = std::fopen(path.c_str(), "w");
+			if (!file) return false;
+			std::fputs("{\"traceEvents\":[\n", file);
+			for (size_t i = 0; i < trace.size(); i++)
+			{
+				auto& event = trace[i];
+				std::string name;
+				for (auto c : *event.name)
+				{
+					if (c == '"' || c == '\\') name += '\\';
+					name += c;
+				}
+				std::fprintf(file, "{\"name\":\"%s\",\"cat\":\"system\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%zu}%s\n",
+					name.c_str(), event.begin, event.duration, event.thread, i + 1 < trace.size() ? "," : "");
+			}
+			std::fputs("]}\n", file);
+			std::fclose(file);
+			return true;
+		}
+
+	private:
+		std::mutex mutex;
+	};
+
+	/// <summary>
+	/// Times a block inside a system under its own name, nothing happens when there is no profiler.
+	/// </summary>
+	struct profile_zone
+	{
+		profile_zone(entt::registry& reg, std::string_view name)
+			: profiler(reg.ctx().find<Profiler>()), name(name)
+		{
+			if (profiler && profiler->enabled) begin = Profiler::clock::now();
+		}
+
+		~profile_zone()
+		{
+			if (profiler && profiler->enabled) profiler->record(name, begin, Profiler::clock::now(), thread_pool::current_thread_index());
+		}
+
+	private:
+		Profiler* profiler;
+		std::string_view name;
+		Profiler::clock::time_point begin;
+	};
+
+	// turns the organizer's type name for a system (an integral_constant over the function pointer) into the function's name,
+	// empty for systems emplaced as plain function pointers
+	std::string system_name(const entt::organizer::vertex& node)
+	{
+		if (node.name()) return node.name();
+		std::string_view name = node.info().name();
+		auto comma = name.rfind(',');
+		if (comma == std::string_view::npos) return {};
+		name.remove_prefix(comma + 1);
+		while (!name.empty() && (name.front() == ' ' || name.front() == '&')) name.remove_prefix(1);
+		while (!name.empty() && name.back() == ' ') name.remove_suffix(1);
+		if (!name.empty() && name.back() == '>') name.remove_suffix(1);
+		while (!name.empty() && name.back() == ' ') name.remove_suffix(1);
+		return std::string(name);
+	}
+}
\ No newline at end of file
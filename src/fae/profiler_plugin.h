@@ -0,0 +1,74 @@
+#pragma once
+#include "fae.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace fae
+{
+	void draw_profiler_overlay(const void*, entt::registry& reg)
+	{
+		auto& profiler = reg.ctx().at<Profiler>();
+		if (auto input = reg.ctx().find<Input>(); input && input->IsKeyPressed(profiler.overlayToggleKey))
+		{
+			profiler.drawOverlay = !profiler.drawOverlay;
+		}
+		if (!profiler.drawOverlay) return;
+
+		// fixedUpdate may be recording from the simulation thread meanwhile
+		auto lock = profiler.lock();
+		std::vector<std::pair<float, const std::string*>> rows;
+		for (auto& [name, stats] : profiler.stats) rows.push_back({ stats.avg(), &name });
+		std::sort(rows.begin(), rows.end(), [](auto& a, auto& b) { return a.first > b.first; });
+		rows.resize(std::min(rows.size(), profiler.overlayRows));
+
+		int fontSize = 10;
+		int lineHeight = fontSize + 2;
+		int x = 8, y = 8;
+		DrawRectangle(x - 4, y - 4, 520, lineHeight * (int)(rows.size() + 1) + 8, Fade(BLACK, 0.7f));
+		DrawText("system                                   avg ms   min ms   p99 ms", x, y, fontSize, YELLOW);
+		for (auto& [avg, name] : rows)
+		{
+			y += lineHeight;
+			auto& stats = profiler.stats.find(*name)->second;
+			DrawText(TextFormat("%-40.40s %8.3f %8.3f %8.3f", name->c_str(), avg, stats.min(), stats.p99()), x, y, fontSize, WHITE);
+		}
+	}
+
+	void write_profiler_trace(const void*, entt::registry& reg)
+	{
+		auto& profiler = reg.ctx().at<Profiler>();
+		if (profiler.tracePath.empty()) return;
+		if (profiler.write_trace(profiler.tracePath))
+		{
+			TraceLog(LOG_INFO, "PROFILER: wrote %zu events to %s", profiler.trace.size(), profiler.tracePath.c_str());
+		}
+		else
+		{
+			TraceLog(LOG_WARNING, "PROFILER: could not write %s", profiler.tracePath.c_str());
+		}
+	}
+
+	/// <summary>
+	/// Reads --trace path from the command line to write a Chrome trace of the run.
+	/// </summary>
+	void configure_profiler(entt::registry& reg, int argc, char** argv)
+	{
+		for (int i = 1; i + 1 < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--trace") == 0)
+			{
+				reg.ctx().emplace<Profiler>().tracePath = argv[i + 1];
+			}
+		}
+	}
+
+	// emplace a configured Profiler into the context before running to change its defaults
+	void profiler_plugin(const void*, entt::registry& reg)
+	{
+		if (!reg.ctx().contains<Profiler>()) reg.ctx().emplace<Profiler>();
+		auto& app = reg.ctx().at<application&>();
+		app.systems.postRender.emplace(draw_profiler_overlay);
+		app.systems.postStop.emplace(write_profiler_trace);
+	}
+}
\ No newline at end of file
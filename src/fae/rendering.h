@@ -1,5 +1,7 @@
 #pragma once
 #include "fae.h"
+#include <algorithm>
+#include <vector>
 namespace fae
 {
 	struct WindowDescriptor
@@ -14,6 +16,104 @@ namespace fae
 		Color clearColor = RAYWHITE;
 	};
 
+	// half-open range of grid cells, [xBegin, xEnd) x [yBegin, yEnd)
+	struct CellRange
+	{
+		int xBegin = 0;
+		int yBegin = 0;
+		int xEnd = 0;
+		int yEnd = 0;
+
+		int Width() const { return xEnd - xBegin; }
+		int Height() const { return yEnd - yBegin; }
+		bool Empty() const { return xEnd <= xBegin || yEnd <= yBegin; }
+		bool Contains(int x, int y) const { return x >= xBegin && x < xEnd && y >= yBegin && y < yEnd; }
+	};
+
+	/// <summary>
+	/// CPU-side RGBA buffer for grid-like demos. Systems write colors into pixels and the whole grid
+	/// is drawn with one texture update and one scaled quad instead of a rectangle per cell.
+	/// Filling it never touches the GPU, so it works headless too.
+	/// </summary>
+	struct PixelGrid
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<Color> pixels;
+		Texture2D texture = {};
+
+		void Resize(int newWidth, int newHeight)
+		{
+			width = newWidth;
+			height = newHeight;
+			pixels.assign((size_t)width * height, BLANK);
+		}
+
+		void Clear(Color color) { std::fill(pixels.begin(), pixels.end(), color); }
+		Color& At(int x, int y) { return pixels[x + (size_t)y * width]; }
+		const Color& At(int x, int y) const { return pixels[x + (size_t)y * width]; }
+
+		// raylib image viewing the pixels, not a copy
+		Image ToImage() const { return { (void*)pixels.data(), width, height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 }; }
+	};
+
+	void upload_pixel_grid(PixelGrid& grid)
+	{
+		if (grid.texture.id == 0 || grid.texture.width != grid.width || grid.texture.height != grid.height)
+		{
+			if (grid.texture.id != 0) UnloadTexture(grid.texture);
+			grid.texture = LoadTextureFromImage(grid.ToImage());
+			return;
+		}
+		UpdateTexture(grid.texture, grid.pixels.data());
+	}
+
+	void draw_pixel_grid(PixelGrid& grid, Rectangle destination, Color tint = WHITE)
+	{
+		upload_pixel_grid(grid);
+		Rectangle source = { 0, 0, (float)grid.width, (float)grid.height };
+		DrawTexturePro(grid.texture, source, destination, { 0, 0 }, 0, tint);
+	}
+
+	// draws only the given cells, for a grid laid out from origin with square cells of cellSize
+	void draw_pixel_grid(PixelGrid& grid, Vector2 origin, float cellSize, CellRange cells, Color tint = WHITE)
+	{
+		if (cells.Empty()) return;
+		upload_pixel_grid(grid);
+		Rectangle source = { (float)cells.xBegin, (float)cells.yBegin, (float)cells.Width(), (float)cells.Height() };
+		Rectangle destination = { origin.x + cells.xBegin * cellSize, origin.y + cells.yBegin * cellSize, cells.Width() * cellSize, cells.Height() * cellSize };
+		DrawTexturePro(grid.texture, source, destination, { 0, 0 }, 0, tint);
+	}
+
+	void unload_pixel_grid(PixelGrid& grid)
+	{
+		if (grid.texture.id == 0) return;
+		UnloadTexture(grid.texture);
+		grid.texture = {};
+	}
+
+	// software path, writes the pixels as an image file without needing a window
+	bool export_pixel_grid(const PixelGrid& grid, const char* path)
+	{
+		return ExportImage(grid.ToImage(), path);
+	}
+
+	// writes the grid to the headless snapshot path, if one was given
+	void export_headless_snapshot(entt::registry& reg, const PixelGrid& grid)
+	{
+		auto headless = reg.ctx().find<HeadlessDescriptor>();
+		if (!headless || headless->snapshotPath.empty()) return;
+		if (!export_pixel_grid(grid, headless->snapshotPath.c_str()))
+		{
+			TraceLog(LOG_WARNING, "HEADLESS: could not write snapshot %s", headless->snapshotPath.c_str());
+		}
+	}
+
+	void end_rendering(const void*, entt::registry& reg)
+	{
+		EndDrawing();
+	}
+
 	void setup_rendering(const void*, entt::registry& reg)
 	{
 		WindowDescriptor descriptor;
@@ -23,6 +123,16 @@ namespace fae
 		}
 		InitWindow(descriptor.width, descriptor.height, descriptor.title);
 		reg.ctx().emplace<Renderer>();
+
+		// emplaced here rather than in the plugin so it comes after every other plugin's postRender systems
+		auto& app = reg.ctx().at<application&>();
+		app.systems.postRender.emplace(end_rendering);
+	}
+
+	void setup_headless_rendering(const void*, entt::registry& reg)
+	{
+		reg.ctx().emplace<Renderer>();
+		reg.ctx().emplace<HeadlessStats>().begin = std::chrono::steady_clock::now();
 	}
 
 	void stop_app_on_window_close(const void*, entt::registry& reg)
@@ -34,6 +144,20 @@ namespace fae
 		}
 	}
 
+	void stop_app_after_headless_frames(const void*, entt::registry& reg)
+	{
+		auto& stats = reg.ctx().at<HeadlessStats>();
+		stats.frames++;
+		auto& descriptor = reg.ctx().at<HeadlessDescriptor>();
+		if (stats.frames == descriptor.warmupFrames) stats.allocationsAfterWarmup = heapAllocations;
+		if (stats.frames >= descriptor.frames)
+		{
+			stats.allocationsAtEnd = heapAllocations;
+			auto& app = reg.ctx().at<application&>();
+			app.isRunning = false;
+		}
+	}
+
 	void begin_rendering(const void*, entt::registry& reg)
 	{
 		BeginDrawing();
@@ -41,23 +165,41 @@ namespace fae
 		ClearBackground(renderer.clearColor);
 	}
 
-	void end_rendering(const void*, entt::registry& reg)
+	void cleanup_renderer(const void*, entt::registry& reg)
 	{
-		EndDrawing();
+		CloseWindow();
 	}
 
-	void cleanup_renderer(const void*, entt::registry& reg)
+	void report_headless_run(const void*, entt::registry& reg)
 	{
-		CloseWindow();
+		auto& stats = reg.ctx().at<HeadlessStats>();
+		stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - stats.begin).count();
+		TraceLog(LOG_INFO, "HEADLESS: %zu frames in %.3f s (%.1f frames/s, %.3f ms/frame)",
+			stats.frames, stats.seconds, stats.frames / stats.seconds, stats.seconds * 1000.0 / stats.frames);
+
+		auto& descriptor = reg.ctx().at<HeadlessDescriptor>();
+		if (countingAllocations && stats.frames > descriptor.warmupFrames)
+		{
+			size_t steadyFrames = stats.frames - descriptor.warmupFrames;
+			size_t allocations = stats.allocationsAtEnd - stats.allocationsAfterWarmup;
+			TraceLog(LOG_INFO, "HEADLESS: %zu heap allocations in the last %zu frames (%.2f per frame)",
+				allocations, steadyFrames, double(allocations) / steadyFrames);
+		}
 	}
 
 	void rendering_plugin(const void*, entt::registry& reg)
 	{
 		auto& app = reg.ctx().at<application&>();
+		if (is_headless(reg))
+		{
+			app.systems.preStart.emplace(setup_headless_rendering);
+			app.systems.postUpdate.emplace(stop_app_after_headless_frames);
+			app.systems.postStop.emplace(report_headless_run);
+			return;
+		}
 		app.systems.preStart.emplace(setup_rendering);
 		app.systems.preUpdate.emplace(stop_app_on_window_close);
-		app.systems.preUpdate.emplace(begin_rendering);
-		app.systems.postUpdate.emplace(end_rendering);
+		app.systems.preRender.emplace(begin_rendering);
 		app.systems.postStop.emplace(cleanup_renderer);
 	}
 }
\ No newline at end of file
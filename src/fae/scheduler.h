@@ -0,0 +1,283 @@
+#pragma once
+#include "fae.h"
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fae
+{
+	/// <summary>
+	/// Tag resource for systems that have to run on the main thread (anything calling into raylib).
+	/// Pass it as an extra required type when emplacing the system.
+	/// </summary>
+	struct main_thread {};
+
+	/// <summary>
+	/// One stage of the application loop. Wraps an organizer and keeps the compiled execution plan
+	/// around until another system is emplaced, so the graph isn't rebuilt every frame.
+	/// </summary>
+	struct phase
+	{
+		// used for systems the profiler can't name, like plain function pointers
+		const char* name = "phase";
+
+		phase() = default;
+		explicit phase(const char* name) : name(name) {}
+
+		template<auto Candidate, typename... Req, typename... Args>
+		phase& emplace(Args&&... args)
+		{
+			organizer.template emplace<Candidate, Req...>(std::forward<Args>(args)...);
+			invalidate();
+			return *this;
+		}
+
+		template<typename... Req>
+		phase& emplace(entt::organizer::function_type* func, const void* payload = nullptr, const char* name = nullptr)
+		{
+			organizer.template emplace<Req...>(func, payload, name);
+			invalidate();
+			return *this;
+		}
+
+		void invalidate() { compiled = false; }
+		bool is_compiled() const { return compiled; }
+		size_t size() const { return plan.graph.size(); }
+
+	private:
+		friend struct scheduler;
+
+		struct node
+		{
+			std::vector<entt::id_type> ro;
+			std::vector<entt::id_type> rw;
+			// nodes without any declared resource may touch anything, so they run alone
+			bool exclusive = false;
+			bool pinned = false;
+			size_t dependencies = 0;
+			std::vector<size_t> next;
+		};
+
+		struct execution_plan
+		{
+			std::vector<entt::organizer::vertex> graph;
+			std::vector<std::string> names;
+			std::vector<node> nodes;
+			std::vector<size_t> roots;
+			// scratch reused by every parallel run
+			std::vector<size_t> pending;
+			std::vector<size_t> mainThreadQueue;
+		};
+
+		entt::organizer organizer;
+		execution_plan plan;
+		bool compiled = false;
+	};
+
+	/// <summary>
+	/// Runs the nodes of a phase either one after the other or, in parallel mode,
+	/// concurrently on a worker pool whenever their read-only/read-write resources don't overlap.
+	/// </summary>
+	struct scheduler
+	{
+		enum class execution_mode
+		{
+			serial,
+			parallel,
+		};
+
+		execution_mode mode = execution_mode::serial;
+		// 0 picks one worker per hardware thread minus the main thread
+		size_t workerCount = 0;
+
+		void run(phase& phase, entt::registry& reg)
+		{
+			if (!phase.compiled) compile(phase, reg);
+			auto& plan = phase.plan;
+			auto profiler = reg.ctx().find<Profiler>();
+			if (profiler && !profiler->enabled) profiler = nullptr;
+
+			if (mode == execution_mode::serial || plan.graph.size() < 2)
+			{
+				for (size_t i = 0; i < plan.graph.size(); i++)
+				{
+					invoke(plan, i, reg, profiler);
+				}
+				return;
+			}
+
+			run_parallel(plan, reg, profiler);
+		}
+
+		/// <summary>
+		/// Builds the graph, prepares every node's pools once and precomputes the dependency edges used in parallel mode.
+		/// </summary>
+		void compile(phase& phase, entt::registry& reg)
+		{
+			auto& plan = phase.plan;
+			plan.graph = phase.organizer.graph();
+			plan.names.clear();
+			for (auto&& node : plan.graph)
+			{
+				node.prepare(reg);
+				auto name = system_name(node);
+				if (name.empty()) name = std::string(phase.name) + " #" + std::to_string(plan.names.size());
+				plan.names.push_back(std::move(name));
+			}
+
+			// the organizer makes every system taking the registry depend on it, which would chain everything,
+			// so the edges are rebuilt from the declared resources only, keeping emplace order between conflicting nodes
+			auto& nodes = plan.nodes;
+			nodes.assign(plan.graph.size(), {});
+			plan.roots.clear();
+			auto mainThreadId = entt::type_id<main_thread>().hash();
+			for (size_t i = 0; i < nodes.size(); i++)
+			{
+				auto& current = nodes[i];
+				current.ro = dependencies(plan.graph[i], false);
+				current.rw = dependencies(plan.graph[i], true);
+				current.exclusive = current.ro.empty() && current.rw.empty();
+				current.pinned = current.exclusive
+					|| std::find(current.ro.begin(), current.ro.end(), mainThreadId) != current.ro.end()
+					|| std::find(current.rw.begin(), current.rw.end(), mainThreadId) != current.rw.end();
+
+				for (size_t j = 0; j < i; j++)
+				{
+					if (!conflicts(nodes[j], current)) continue;
+					nodes[j].next.push_back(i);
+					current.dependencies++;
+				}
+				if (current.dependencies == 0) plan.roots.push_back(i);
+			}
+			plan.pending.resize(nodes.size());
+			plan.mainThreadQueue.reserve(nodes.size());
+			phase.compiled = true;
+		}
+
+		thread_pool& pool()
+		{
+			if (!workers) workers = std::make_unique<thread_pool>(workerCount);
+			return *workers;
+		}
+
+	private:
+		std::unique_ptr<thread_pool> workers;
+
+		static std::vector<entt::id_type> dependencies(const entt::organizer::vertex& node, bool rw)
+		{
+			std::vector<const entt::type_info*> buffer(rw ? node.rw_count() : node.ro_count());
+			if (rw) node.rw_dependency(buffer.data(), buffer.size());
+			else node.ro_dependency(buffer.data(), buffer.size());
+
+			std::vector<entt::id_type> ids;
+			ids.reserve(buffer.size());
+			for (auto info : buffer) ids.push_back(info->hash());
+			return ids;
+		}
+
+		static void invoke(const phase::execution_plan& plan, size_t i, entt::registry& reg, Profiler* profiler)
+		{
+			auto& node = plan.graph[i];
+			if (!profiler)
+			{
+				node.callback()(node.data(), reg);
+				return;
+			}
+			auto begin = Profiler::clock::now();
+			node.callback()(node.data(), reg);
+			profiler->record(plan.names[i], begin, Profiler::clock::now(), thread_pool::current_thread_index());
+		}
+
+		static bool overlaps(const std::vector<entt::id_type>& a, const std::vector<entt::id_type>& b)
+		{
+			for (auto id : a)
+			{
+				if (std::find(b.begin(), b.end(), id) != b.end()) return true;
+			}
+			return false;
+		}
+
+		static bool conflicts(const phase::node& a, const phase::node& b)
+		{
+			if (a.exclusive || b.exclusive) return true;
+			return overlaps(a.rw, b.rw) || overlaps(a.rw, b.ro) || overlaps(a.ro, b.rw);
+		}
+
+		// state of one parallel run of a phase, lives on the stack of run_parallel
+		struct parallel_run
+		{
+			scheduler* self;
+			phase::execution_plan& plan;
+			entt::registry& reg;
+			Profiler* profiler;
+			std::mutex mutex = {};
+			std::condition_variable finished = {};
+			size_t mainThreadNext = 0;
+			size_t done = 0;
+		};
+
+		// expects run.mutex to be held
+		void dispatch(parallel_run& run, size_t i)
+		{
+			if (run.plan.nodes[i].pinned)
+			{
+				run.plan.mainThreadQueue.push_back(i);
+				return;
+			}
+			// two words of captures fit in std::function's small buffer, so submitting doesn't allocate
+			pool().submit([&run, i]
+			{
+				invoke(run.plan, i, run.reg, run.profiler);
+				std::scoped_lock lock(run.mutex);
+				run.self->finish(run, i);
+				run.finished.notify_all();
+			});
+		}
+
+		// expects run.mutex to be held
+		void finish(parallel_run& run, size_t i)
+		{
+			for (auto child : run.plan.nodes[i].next)
+			{
+				if (--run.plan.pending[child] == 0) dispatch(run, child);
+			}
+			run.done++;
+		}
+
+		void run_parallel(phase::execution_plan& plan, entt::registry& reg, Profiler* profiler)
+		{
+			auto& nodes = plan.nodes;
+			for (size_t i = 0; i < nodes.size(); i++)
+			{
+				plan.pending[i] = nodes[i].dependencies;
+			}
+			plan.mainThreadQueue.clear();
+
+			parallel_run run{ this, plan, reg, profiler };
+			std::unique_lock lock(run.mutex);
+			for (auto root : plan.roots)
+			{
+				dispatch(run, root);
+			}
+
+			while (run.done < nodes.size())
+			{
+				if (run.mainThreadNext == plan.mainThreadQueue.size())
+				{
+					run.finished.wait(lock);
+					continue;
+				}
+
+				auto i = plan.mainThreadQueue[run.mainThreadNext++];
+				lock.unlock();
+				invoke(plan, i, reg, profiler);
+				lock.lock();
+				finish(run, i);
+			}
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,201 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fae
+{
+	/// <summary>
+	/// Fixed set of worker threads consuming a shared task queue.
+	/// parallel_for lets the calling thread take chunks too, so it is safe to call from inside a task.
+	/// </summary>
+	struct thread_pool
+	{
+		explicit thread_pool(size_t workerCount = 0)
+		{
+			if (workerCount == 0)
+			{
+				workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+				workerCount = std::max<size_t>(workerCount, 1);
+			}
+			workers.reserve(workerCount);
+			for (size_t i = 0; i < workerCount; i++)
+			{
+				workers.emplace_back([this, i] { work(i + 1); });
+			}
+		}
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		~thread_pool()
+		{
+			{
+				std::scoped_lock lock(mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (auto& worker : workers) worker.join();
+		}
+
+		size_t size() const { return workers.size(); }
+
+		// 0 for threads that are not part of the pool, 1..size() for workers
+		static size_t current_thread_index() { return threadIndex(); }
+
+		void submit(std::function<void()> task)
+		{
+			{
+				std::scoped_lock lock(mutex);
+				push(std::move(task));
+			}
+			wake.notify_one();
+		}
+
+		/// <summary>
+		/// Calls fn(chunkBegin, chunkEnd) over [begin, end) split in chunks of at most grain items and blocks until all chunks ran.
+		/// </summary>
+		template<typename Fn>
+		void parallel_for(size_t begin, size_t end, size_t grain, Fn&& fn)
+		{
+			if (end <= begin) return;
+			grain = std::max<size_t>(grain, 1);
+			size_t chunks = (end - begin + grain - 1) / grain;
+			if (chunks == 1)
+			{
+				fn(begin, end);
+				return;
+			}
+
+			// lives on this stack, helpers only carry a pointer to it so submitting them doesn't allocate
+			using Body = std::remove_reference_t<Fn>;
+			loop state{ *this, begin, end, grain, chunks, (void*)&fn, [](void* fn, size_t chunkBegin, size_t chunkEnd) { (*static_cast<Body*>(fn))(chunkBegin, chunkEnd); } };
+			size_t helpers = std::min(chunks - 1, workers.size());
+			for (size_t i = 0; i < helpers; i++)
+			{
+				submit(helper{ &state });
+			}
+			state.run();
+
+			// every chunk was taken, helpers still queued are dropped and the ones that started are waited for,
+			// so nothing touches state once this returns and the caller never waits on a helper no worker picked up
+			std::unique_lock lock(mutex);
+			size_t started = helpers - cancel(state);
+			helpersDone.wait(lock, [&] { return state.exited == started; });
+		}
+
+	private:
+		struct loop
+		{
+			thread_pool& pool;
+			size_t begin, end, grain, chunks;
+			void* fn;
+			void (*call)(void*, size_t, size_t);
+			std::atomic<size_t> next = 0;
+			// guarded by the pool mutex
+			size_t exited = 0;
+
+			void run()
+			{
+				for (size_t chunk = next++; chunk < chunks; chunk = next++)
+				{
+					size_t chunkBegin = begin + chunk * grain;
+					call(fn, chunkBegin, std::min(end, chunkBegin + grain));
+				}
+			}
+		};
+
+		struct helper
+		{
+			loop* state;
+
+			void operator()() const
+			{
+				state->run();
+				auto& pool = state->pool;
+				{
+					std::scoped_lock lock(pool.mutex);
+					state->exited++;
+				}
+				pool.helpersDone.notify_all();
+			}
+		};
+
+		std::vector<std::thread> workers;
+		// ring buffer that only grows, so a steady stream of tasks doesn't allocate queue storage
+		std::vector<std::function<void()>> tasks;
+		size_t head = 0;
+		size_t queued = 0;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable helpersDone;
+		bool stopping = false;
+
+		static size_t& threadIndex()
+		{
+			thread_local size_t index = 0;
+			return index;
+		}
+
+		// expects mutex to be held
+		void push(std::function<void()> task)
+		{
+			if (queued == tasks.size())
+			{
+				std::vector<std::function<void()>> grown(std::max<size_t>(16, tasks.size() * 2));
+				for (size_t i = 0; i < queued; i++) grown[i] = std::move(tasks[(head + i) % tasks.size()]);
+				tasks = std::move(grown);
+				head = 0;
+			}
+			tasks[(head + queued) % tasks.size()] = std::move(task);
+			queued++;
+		}
+
+		// expects mutex to be held and a task to be queued
+		std::function<void()> pop()
+		{
+			auto task = std::move(tasks[head]);
+			tasks[head] = nullptr;
+			head = (head + 1) % tasks.size();
+			queued--;
+			return task;
+		}
+
+		// expects mutex to be held, empties the queued helpers of state and returns how many there were
+		size_t cancel(loop& state)
+		{
+			size_t cancelled = 0;
+			for (size_t i = 0; i < queued; i++)
+			{
+				auto& task = tasks[(head + i) % tasks.size()];
+				auto* queuedHelper = task.target<helper>();
+				if (queuedHelper && queuedHelper->state == &state)
+				{
+					task = nullptr;
+					cancelled++;
+				}
+			}
+			return cancelled;
+		}
+
+		void work(size_t index)
+		{
+			threadIndex() = index;
+			while (true)
+			{
+				std::function<void()> task;
+				{
+					std::unique_lock lock(mutex);
+					wake.wait(lock, [this] { return stopping || queued > 0; });
+					if (stopping && queued == 0) return;
+					task = pop();
+				}
+				if (task) task();
+			}
+		}
+	};
+}
\ No newline at end of file
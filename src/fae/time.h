@@ -0,0 +1,40 @@
+#pragma once
+#include "fae.h"
+
+namespace fae
+{
+	struct Time
+	{
+		// seconds since the previous frame, fixed when headless
+		float dt = 0;
+		double elapsed = 0;
+		// 1-based number of the current frame
+		size_t frame = 0;
+	};
+
+	void setup_time(const void*, entt::registry& reg)
+	{
+		reg.ctx().emplace<Time>();
+	}
+
+	void update_time(const void*, entt::registry& reg)
+	{
+		auto& time = reg.ctx().at<Time>();
+		auto headless = reg.ctx().find<HeadlessDescriptor>();
+		time.dt = headless ? headless->dt : GetFrameTime();
+		time.elapsed += time.dt;
+		time.frame++;
+
+		if (auto fixed = reg.ctx().find<FixedTimestep>())
+		{
+			fixed->accumulator += time.dt;
+		}
+	}
+
+	void time_plugin(const void*, entt::registry& reg)
+	{
+		auto& app = reg.ctx().at<application&>();
+		app.systems.preStart.emplace(setup_time);
+		app.systems.preUpdate.emplace(update_time);
+	}
+}
\ No newline at end of file
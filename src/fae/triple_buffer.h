@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace fae
+{
+	/// <summary>
+	/// Lock-free hand-off of whole values from one producer thread to one consumer thread.
+	/// The producer always owns a slot to write into and the consumer always owns the latest published one,
+	/// so neither side ever waits and a slow consumer just skips the snapshots it missed.
+	/// </summary>
+	template<typename T>
+	struct triple_buffer
+	{
+		triple_buffer() = default;
+		explicit triple_buffer(const T& initial) : buffers{ initial, initial, initial } {}
+
+		// producer side, the slot being filled
+		T& write_buffer() { return buffers[writeIndex]; }
+
+		// producer side, hands the filled slot over and takes the one the consumer isn't using
+		void publish()
+		{
+			writeIndex = shared.exchange(writeIndex | freshBit, std::memory_order_acq_rel) & indexMask;
+		}
+
+		// consumer side, swaps in the latest published slot. Returns false when nothing new was published
+		bool consume()
+		{
+			if ((shared.load(std::memory_order_relaxed) & freshBit) == 0) return false;
+			readIndex = shared.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+			return true;
+		}
+
+		// consumer side, the slot swapped in by the last consume
+		const T& read_buffer() const { return buffers[readIndex]; }
+
+	private:
+		static constexpr uint8_t indexMask = 0b011;
+		static constexpr uint8_t freshBit = 0b100;
+
+		T buffers[3];
+		uint8_t writeIndex = 0;
+		uint8_t readIndex = 1;
+		// index of the slot in between, plus whether it was published since the last consume
+		std::atomic<uint8_t> shared = 2;
+	};
+}
\ No newline at end of file
@@ -1,238 +1,1164 @@
 #pragma once
 #include "../fae/fae.h"
+#include "fluid_pressure.h"
+#include "fluid_recording.h"
+#include "fluid_tracers.h"
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <variant>
 // reference https://www.youtube.com/watch?v=alhpH6ECFvQ
 struct fluid : public fae::application
 {
-	static const int N = 128;
-	static const int SCALE = 4;
-	static const int iter = 4;
-	static const int dt = 0.1;
+	// command line settings, read once by setup
+	struct Descriptor
+	{
+		// cells per side, 128, 256, 512 and 1024 run size-specialized kernels, any other size the generic ones
+		int size = 128;
+		// N * N is an int throughout the solver, and this is far past what steps in real time anyway
+		static constexpr int maxSize = 8192;
+		// pixels per cell
+		int scale = 4;
+		// gauss-seidel sweeps per linear solve
+		int iterations = 4;
+		// simulation time per step, independent of the fixed timestep the steps run at
+		float dt = 0.1f;
+		// store the six fields as bfloat16 instead of float
+		bool bfloat16 = false;
+		// advect velocity, density and dye in one pass
+		bool fusedAdvection = false;
+		// carry RGB dye along with the density, injected in a cycling hue
+		bool dye = false;
+		// only simulate the tiles of the grid with something in them
+		bool sparse = false;
+		// massless particles carried by the velocity, drawn over the density
+		size_t tracers = 0;
+		// stream every step's density and velocity to this file
+		std::string recordPath;
+		RecordingEncoding recordEncoding = RecordingEncoding::delta;
+		// play this recording back instead of simulating, its grid size replaces size
+		std::string replayPath;
+	};
 
-	struct Fluid
+	/// <summary>
+	/// Reads --size N [--scale pixels] [--iterations sweeps] [--timestep dt] [--bfloat16] [--fused-advection] [--dye] [--sparse]
+	/// [--tracers count] [--record file] [--record-encoding raw|quantized|delta] [--replay file] from the command line.
+	/// </summary>
+	static void configure(entt::registry& reg, int argc, char** argv)
 	{
+		Descriptor descriptor;
+		for (int i = 1; i < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) descriptor.size = std::clamp(std::atoi(argv[++i]), 8, Descriptor::maxSize);
+			else if (std::strcmp(argv[i], "--scale") == 0 && i + 1 < argc) descriptor.scale = std::max(1, std::atoi(argv[++i]));
+			else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) descriptor.iterations = std::max(1, std::atoi(argv[++i]));
+			else if (std::strcmp(argv[i], "--timestep") == 0 && i + 1 < argc) descriptor.dt = std::strtof(argv[++i], nullptr);
+			else if (std::strcmp(argv[i], "--bfloat16") == 0) descriptor.bfloat16 = true;
+			else if (std::strcmp(argv[i], "--fused-advection") == 0) descriptor.fusedAdvection = true;
+			else if (std::strcmp(argv[i], "--dye") == 0) descriptor.dye = true;
+			else if (std::strcmp(argv[i], "--sparse") == 0) descriptor.sparse = true;
+			else if (std::strcmp(argv[i], "--tracers") == 0 && i + 1 < argc) descriptor.tracers = std::strtoull(argv[++i], nullptr, 10);
+			else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) descriptor.recordPath = argv[++i];
+			else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) descriptor.replayPath = argv[++i];
+			else if (std::strcmp(argv[i], "--record-encoding") == 0 && i + 1 < argc)
+			{
+				const char* name = argv[++i];
+				for (auto encoding : { RecordingEncoding::raw, RecordingEncoding::quantized, RecordingEncoding::delta })
+				{
+					if (std::strcmp(name, recording_encoding_name(encoding)) == 0) descriptor.recordEncoding = encoding;
+				}
+			}
+		}
+		reg.ctx().emplace<Descriptor>(descriptor);
+	}
+
+	/// <summary>
+	/// Stable fluids on an N x N grid with fields stored as T, float or fae::math::bfloat16. Arithmetic is always float,
+	/// 16-bit fields are widened as they're read and rounded as they're written, halving the memory the stages stream through.
+	/// The pressure solve keeps float buffers of its own either way.
+	/// </summary>
+	template<typename T>
+	struct BasicFluid
+	{
+		int N = 128;
+		int iter = 4;
+		float dt = 0.1f;
 		float diff = 0;
 		float visc = 0;
 
-		std::vector<float> s;
-		std::vector<float> density;
-		std::vector<float> Vx;
-		std::vector<float> Vy;
-		std::vector<float> Vx0;
-		std::vector<float> Vy0;
+		std::vector<T> s;
+		std::vector<T> density;
+		std::vector<T> Vx;
+		std::vector<T> Vy;
+		std::vector<T> Vx0;
+		std::vector<T> Vy0;
+		// red, green and blue, empty until enableDye
+		std::array<std::vector<T>, 3> dye;
+		std::array<std::vector<T>, 3> dye0;
+
+		// advects velocity, density and dye in one pass along the velocity at the start of the step, instead of one pass each
+		// with density and dye following the velocity at the end of it. Looks the same, but the results aren't identical
+		bool fusedAdvection = false;
+
+		// every stage is split in row bands over this pool when set, the result is the same with or without it
+		fae::thread_pool* pool = nullptr;
+
+		// iter fixed gauss-seidel sweeps by default, the others iterate until the relative residual is under pressureTolerance
+		PressureSolver pressureSolver = PressureSolver::gauss_seidel;
+		float pressureTolerance = 1e-4f;
+		int maxPressureIterations = 64;
+		// summed over both projections of the last step, residual is the worse of the two
+		SolveStats pressureStats;
+		MultigridSolver multigrid;
+		ConjugateGradientSolver conjugateGradient;
+		std::vector<double> pressureRowSums;
+		std::vector<float> pressureResidual;
+		// pressure and divergence for 16-bit fields, float fields let project use the velocities it's about to overwrite
+		std::vector<float> projectPressure;
+		std::vector<float> projectDivergence;
+
+		// at most velocity, density and dye go through one advection
+		static constexpr int maxAdvectedFields = 6;
+
+		// advect scratch, two rows of backtraced positions and a row of samples per field for each thread, and the column index of each interior cell
+		std::vector<float> advectScratch;
+		std::vector<float> advectColumns;
 
-		Fluid(float diff, float visc)
+		// Sparse mode steps only the tileSize x tileSize tiles with density, dye or velocity over activityThreshold, grown by a halo
+		// as wide as one step can carry them. Cells of inactive tiles are zero in every field and no stage reads or writes them,
+		// tiles are cleared as they go inactive, so what falls under activityThreshold is dropped and the result is approximate.
+		// The pressure solve is limited to the box around the active tiles with zero pressure at its edge, like at the walls,
+		// which agrees with the full solve for the fixed gauss-seidel sweeps as long as the halo is wider than they reach,
+		// and only roughly for the solvers that converge
+		bool sparse = false;
+		float activityThreshold = 1e-3f;
+		static constexpr int tileSize = 16;
+
+		// interior columns [begin, end) of a row
+		struct Span
+		{
+			int begin;
+			int end;
+		};
+
+		// per side, tile (x, y) is activeTiles[x + y * tiles]. Everything is active until the first sparse step
+		int tiles = 0;
+		std::vector<uint8_t> activeTiles;
+		int activeTileCount = 0;
+		// tiles added to since the last step, they can go from nothing to live without being active
+		std::vector<uint8_t> touchedTiles;
+		std::vector<uint8_t> liveTiles;
+		std::vector<uint8_t> grownTiles;
+		std::vector<float> tileRowSpeeds;
+		// runs of active tiles, those of tile row t are activeRuns[activeRunOffsets[t], activeRunOffsets[t + 1])
+		std::vector<Span> activeRuns;
+		std::vector<int> activeRunOffsets;
+		// the interior cells of the active tiles are all in here
+		fae::CellRange activeCells;
+		Span fullRow;
+		// the active box with a ring around it, pressure is solved on it in sparse mode
+		std::vector<float> activePressure;
+		std::vector<float> activeDivergence;
+
+		BasicFluid(float diff, float visc, int size = 128) : N(size), diff(diff), visc(visc)
 		{
-			s.resize(N * N, 0);
-			density.resize(N * N, 0);
-			Vx.resize(N * N, 0);
-			Vy.resize(N * N, 0);
-			Vx0.resize(N * N, 0);
-			Vy0.resize(N * N, 0);
+			s.resize(N * N);
+			density.resize(N * N);
+			Vx.resize(N * N);
+			Vy.resize(N * N);
+			Vx0.resize(N * N);
+			Vy0.resize(N * N);
+			if constexpr (!std::is_same_v<T, float>)
+			{
+				projectPressure.resize(N * N);
+				projectDivergence.resize(N * N);
+			}
+			advectColumns.resize(N - 2);
+			for (int i = 1; i < N - 1; i++) advectColumns[i - 1] = i;
+
+			tiles = (N + tileSize - 1) / tileSize;
+			activeTiles.assign(tiles * tiles, 1);
+			activeTileCount = tiles * tiles;
+			touchedTiles.resize(tiles * tiles);
+			liveTiles.resize(tiles * tiles);
+			grownTiles.resize(tiles * tiles);
+			tileRowSpeeds.resize(tiles);
+			activeRunOffsets.resize(tiles + 1);
+			activeCells = { 1, 1, N - 1, N - 1 };
+			fullRow = { 1, N - 1 };
 		}
 
+		static float load(T value) { return fae::math::to_float(value); }
+		static T store(float value) { return fae::math::from_float<T>(value); }
+
 		int ix(int x, int y) {
 			x = Clamp(x, 0, N - 1);
-			y = Clamp(x, 0, N - 1);
+			y = Clamp(y, 0, N - 1);
 			return x + y * N;
 		}
 
+		void touch(int cell)
+		{
+			touchedTiles[cell % N / tileSize + cell / N / tileSize * tiles] = 1;
+		}
+
 		void addDensity(Vector2 i, float amount)
 		{
-			density[ix(i.x, i.y)] += amount;
+			touch(ix(i.x, i.y));
+			auto& d = density[ix(i.x, i.y)];
+			d = store(load(d) + amount);
 		}
 
 		void addVelocity(Vector2 i, Vector2 amount)
 		{
-			Vx[ix(i.x, i.y)] += amount.x;
-			Vy[ix(i.x, i.y)] += amount.y;
+			touch(ix(i.x, i.y));
+			auto& x = Vx[ix(i.x, i.y)];
+			auto& y = Vy[ix(i.x, i.y)];
+			x = store(load(x) + amount.x);
+			y = store(load(y) + amount.y);
+		}
+
+		void enableDye()
+		{
+			for (auto& channel : dye) channel.resize(N * N);
+			for (auto& channel : dye0) channel.resize(N * N);
 		}
 
-		void diffuse(int b, float x[], float x0[], float diff)
+		bool hasDye() const { return !dye[0].empty(); }
+
+		void addDye(Vector2 i, Vector3 amount)
+		{
+			if (!hasDye()) return;
+			int cell = ix(i.x, i.y);
+			touch(cell);
+			float channels[] = { amount.x, amount.y, amount.z };
+			for (int c = 0; c < 3; c++) dye[c][cell] = store(load(dye[c][cell]) + channels[c]);
+		}
+
+		// density widened to float, out is resized to N * N
+		void copyDensity(std::vector<float>& out) const
+		{
+			out.resize(density.size());
+			widen_field(density, out.data());
+		}
+
+		// x and y velocity widened to float, each resized to N * N
+		void copyVelocity(std::vector<float>& outX, std::vector<float>& outY) const
+		{
+			outX.resize(Vx.size());
+			outY.resize(Vy.size());
+			widen_field(Vx, outX.data());
+			widen_field(Vy, outY.data());
+		}
+
+		// red, green and blue planes of N * N one after the other, out is left empty without dye
+		void copyDye(std::vector<float>& out) const
+		{
+			if (!hasDye())
+			{
+				out.clear();
+				return;
+			}
+			out.resize(3 * density.size());
+			for (int c = 0; c < 3; c++) widen_field(dye[c], out.data() + c * density.size());
+		}
+
+		static void widen_field(const std::vector<T>& field, float* out)
+		{
+			if constexpr (std::is_same_v<T, float>) std::copy(field.begin(), field.end(), out);
+			else fae::math::widen(field, { out, field.size() });
+		}
+
+		void diffuse(int b, T x[], T x0[], float diff)
 		{
 			float a = dt * diff * (N - 2) * (N - 2);
 			lin_solve(b, x, x0, a, 1 + 6 * a);
 		}
 
-		void lin_solve(int b, float x[], float x0[], float a, float c)
+		// Interior stencils below index rows directly (cell i of row j is row[i] with row = field + j * N),
+		// only ix() clamps, and only for positions coming from outside. Edges are left to set_bnd.
+		// They take the grid size as StaticN for the sizes with_size specializes and read size at runtime when it's 0,
+		// and update columns [begin, end) of the row, one of row_runs.
+
+		// Red-black Gauss-Seidel update of the cells of one row with (i + j) % 2 == color. Their four neighbors
+		// all have the other color, so every cell of a color can be updated at once and in any order
+		template<int StaticN, typename U>
+		static void red_black_row(const U* x0, U* row, int j, int color, float a, float cRecip, int size, int begin, int end)
+		{
+			const int N = StaticN ? StaticN : size;
+			int first = begin + ((begin + j + color) & 1);
+#if FAE_X86
+			if constexpr (std::is_same_v<U, float>)
+			{
+				if (fae::math::simd == fae::math::simd_level::avx2) first = red_black_row_avx2(x0, row, first, a, cRecip, N, begin, end);
+			}
+#endif
+			for (int i = first; i < end; i += 2)
+			{
+				float neighbors = fae::math::to_float(row[i + 1]) + fae::math::to_float(row[i - 1]) + fae::math::to_float(row[i + N]) + fae::math::to_float(row[i - N]);
+				row[i] = fae::math::from_float<U>((fae::math::to_float(x0[i]) + a * neighbors) * cRecip);
+			}
+		}
+
+		template<int StaticN>
+		static void divergence_row(const T* velocX, const T* velocY, float* div, float* p, int size, int begin, int end)
+		{
+			const int N = StaticN ? StaticN : size;
+			int i = begin;
+#if FAE_X86
+			if constexpr (std::is_same_v<T, float>)
+			{
+				if (fae::math::simd == fae::math::simd_level::avx2) i = divergence_row_avx2(velocX, velocY, div, p, N, begin, end);
+			}
+#endif
+			for (; i < end; i++)
+			{
+				div[i] = -0.5f * (load(velocX[i + 1]) - load(velocX[i - 1]) + load(velocY[i + N]) - load(velocY[i - N])) / N;
+				p[i] = 0;
+			}
+		}
+
+		template<int StaticN>
+		static void subtract_gradient_row(const float* p, T* velocX, T* velocY, int size, int begin, int end)
+		{
+			const int N = StaticN ? StaticN : size;
+			int i = begin;
+#if FAE_X86
+			if constexpr (std::is_same_v<T, float>)
+			{
+				if (fae::math::simd == fae::math::simd_level::avx2) i = subtract_gradient_row_avx2(p, velocX, velocY, N, begin, end);
+			}
+#endif
+			for (; i < end; i++)
+			{
+				velocX[i] = store(load(velocX[i]) - 0.5f * (p[i + 1] - p[i - 1]) * N);
+				velocY[i] = store(load(velocY[i]) - 0.5f * (p[i + N] - p[i - N]) * N);
+			}
+		}
+
+#if FAE_X86
+		// the avx2 versions do the interior in blocks of 8 and return where the scalar loop has to pick up.
+		// They're float only, the 16-bit fields go through the scalar loops
+
+		// loads and stores are masked to the cells being updated, so nothing of the other color is touched
+		// while neighboring rows are updated by other threads
+		FAE_TARGET_AVX2 static int red_black_row_avx2(const float* x0, float* row, int first, float a, float cRecip, int N, int begin, int end)
+		{
+			// blocks start at begin, so when it's the right color so are the even lanes
+			__m256i mask = first == begin ? _mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0) : _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+			__m256 va = _mm256_set1_ps(a);
+			__m256 vcRecip = _mm256_set1_ps(cRecip);
+			int i = begin;
+			for (; i + 8 <= end; i += 8)
+			{
+				__m256 neighbors = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+					_mm256_maskload_ps(row + i + 1, mask),
+					_mm256_maskload_ps(row + i - 1, mask)),
+					_mm256_maskload_ps(row + i + N, mask)),
+					_mm256_maskload_ps(row + i - N, mask));
+				__m256 updated = _mm256_mul_ps(_mm256_add_ps(_mm256_maskload_ps(x0 + i, mask), _mm256_mul_ps(va, neighbors)), vcRecip);
+				_mm256_maskstore_ps(row + i, mask, updated);
+			}
+			// first cell of the right color at or after i
+			return i + ((i - first) & 1);
+		}
+
+		FAE_TARGET_AVX2 static int divergence_row_avx2(const float* velocX, const float* velocY, float* div, float* p, int N, int begin, int end)
+		{
+			__m256 half = _mm256_set1_ps(-0.5f);
+			__m256 size = _mm256_set1_ps((float)N);
+			__m256 zero = _mm256_setzero_ps();
+			int i = begin;
+			for (; i + 8 <= end; i += 8)
+			{
+				// same order of operations as the scalar loop so both give identical results
+				__m256 sum = _mm256_sub_ps(_mm256_loadu_ps(velocX + i + 1), _mm256_loadu_ps(velocX + i - 1));
+				sum = _mm256_add_ps(sum, _mm256_loadu_ps(velocY + i + N));
+				sum = _mm256_sub_ps(sum, _mm256_loadu_ps(velocY + i - N));
+				_mm256_storeu_ps(div + i, _mm256_div_ps(_mm256_mul_ps(half, sum), size));
+				_mm256_storeu_ps(p + i, zero);
+			}
+			return i;
+		}
+
+		FAE_TARGET_AVX2 static int subtract_gradient_row_avx2(const float* p, float* velocX, float* velocY, int N, int begin, int end)
+		{
+			__m256 half = _mm256_set1_ps(0.5f);
+			__m256 size = _mm256_set1_ps((float)N);
+			int i = begin;
+			for (; i + 8 <= end; i += 8)
+			{
+				__m256 gradientX = _mm256_mul_ps(_mm256_mul_ps(half, _mm256_sub_ps(_mm256_loadu_ps(p + i + 1), _mm256_loadu_ps(p + i - 1))), size);
+				__m256 gradientY = _mm256_mul_ps(_mm256_mul_ps(half, _mm256_sub_ps(_mm256_loadu_ps(p + i + N), _mm256_loadu_ps(p + i - N))), size);
+				_mm256_storeu_ps(velocX + i, _mm256_sub_ps(_mm256_loadu_ps(velocX + i), gradientX));
+				_mm256_storeu_ps(velocY + i, _mm256_sub_ps(_mm256_loadu_ps(velocY + i), gradientY));
+			}
+			return i;
+		}
+#endif
+
+		// calls fn with std::integral_constant<int, N> when N has specialized kernels, and with 0 otherwise
+		template<typename Fn>
+		void with_size(Fn&& fn)
+		{
+			switch (N)
+			{
+			case 128: return fn(std::integral_constant<int, 128>());
+			case 256: return fn(std::integral_constant<int, 256>());
+			case 512: return fn(std::integral_constant<int, 512>());
+			case 1024: return fn(std::integral_constant<int, 1024>());
+			default: return fn(std::integral_constant<int, 0>());
+			}
+		}
+
+		// interior rows [1, N - 1), or those of the active box in sparse mode, in bands over the pool when there is one.
+		// Returning is the barrier between stages. Denormals are flushed on the workers as on the thread calling step
+		template<typename Fn>
+		void for_rows(Fn&& fn)
+		{
+			int begin = sparse ? activeCells.yBegin : 1;
+			int end = sparse ? activeCells.yEnd : N - 1;
+			if (begin >= end) return;
+			if (!pool) return fn(begin, end);
+			int grain = std::max(4, (end - begin) / int(4 * (pool->size() + 1)));
+			pool->parallel_for(begin, end, grain, [&](size_t rowBegin, size_t rowEnd)
+			{
+				fae::math::flush_denormals flush;
+				fn((int)rowBegin, (int)rowEnd);
+			});
+		}
+
+		// the interior columns of row j to update, all of them or the active runs of its tile row
+		std::span<const Span> row_runs(int j) const
+		{
+			if (!sparse) return { &fullRow, 1 };
+			int t = j / tileSize;
+			return { activeRuns.data() + activeRunOffsets[t], activeRuns.data() + activeRunOffsets[t + 1] };
+		}
+
+		void lin_solve(int b, T x[], T x0[], float a, float c)
+		{
+			gauss_seidel(x, x0, a, c);
+			set_bnd(b, x);
+		}
+
+		// iter red-black sweeps over the interior, the outer ring is left as it is
+		template<typename U>
+		void gauss_seidel(U x[], const U x0[], float a, float c)
 		{
 			float cRecip = 1.0f / c;
-			for (int k = 0; k < iter; k++)
+			with_size([&](auto size)
 			{
-				for (int j = 1; j < N - 1; j++)
+				constexpr int StaticN = decltype(size)::value;
+				for (int k = 0; k < iter; k++)
 				{
-					for (int i = 1; i < N - 1; i++)
+					for (int color = 0; color < 2; color++)
 					{
-						x[ix(i, j)] = (x0[ix(i, j)] + a * (x[ix(i + 1, j)] + x[ix(i - 1, j)] + x[ix(i, j + 1)] + x[ix(i, j - 1)])) * cRecip;
+						for_rows([&](int rowBegin, int rowEnd)
+						{
+							for (int j = rowBegin; j < rowEnd; j++)
+							{
+								for (auto run : row_runs(j)) red_black_row<StaticN>(x0 + j * N, x + j * N, j, color, a, cRecip, N, run.begin, run.end);
+							}
+						});
 					}
 				}
+			});
+		}
+
+		// same equation as lin_solve(0, p, div, 1, 6), p's outer ring is zero until set_bnd at the end
+		void solve_pressure(float p[], float div[])
+		{
+			SolveStats stats;
+			switch (pressureSolver)
+			{
+			case PressureSolver::multigrid:
+				if (sparse) stats = solve_active_pressure(p, div);
+				else stats = multigrid.solve(p, div, N, N, 1, 6, pressureTolerance, maxPressureIterations, pool);
+				break;
+			case PressureSolver::conjugate_gradient:
+				if (sparse) stats = solve_active_pressure(p, div);
+				else stats = conjugateGradient.solve(p, div, N, N, 1, 6, pressureTolerance, maxPressureIterations, pool);
+				break;
+			default:
+				if (sparse) stats = solve_active_pressure(p, div);
+				else
+				{
+					gauss_seidel(p, div, 1, 6);
+					stats = sweep_stats(p, div, N, N);
+				}
+				break;
 			}
+			set_bnd(0, p);
+			pressureStats.iterations += stats.iterations;
+			pressureStats.residual = std::max(pressureStats.residual, stats.residual);
+		}
 
-			set_bnd(b, x);
+		// only measured for reporting, the sweep count doesn't depend on it
+		SolveStats sweep_stats(const float* p, const float* div, int width, int height)
+		{
+			pressureResidual.resize(width * height);
+			float bNorm = std::sqrt(pressure::squared_norm(div, width, height, pressureRowSums, pool));
+			float rNorm = std::sqrt(pressure::residual(p, div, pressureResidual.data(), width, height, 1, 6, pressureRowSums, pool));
+			return { iter, bNorm > 0 ? rNorm / bNorm : 0 };
 		}
 
-		void project(float velocX[], float velocY[], float p[], float div[])
+		// copies the active box with the ring around it out of p and div, solves on that and copies the active runs back,
+		// the rest of p stays zero like every field outside the active tiles
+		SolveStats solve_active_pressure(float p[], const float div[])
 		{
-			for (int j = 1; j < N - 1; j++)
+			int left = activeCells.xBegin - 1;
+			int top = activeCells.yBegin - 1;
+			int width = activeCells.Width() + 2;
+			int height = activeCells.Height() + 2;
+			if (width <= 2 || height <= 2) return {};
+
+			activePressure.resize(width * height);
+			activeDivergence.resize(width * height);
+			float* x = activePressure.data();
+			float* b = activeDivergence.data();
+			for (int j = 0; j < height; j++)
+			{
+				std::copy_n(p + left + (top + j) * N, width, x + j * width);
+				std::copy_n(div + left + (top + j) * N, width, b + j * width);
+			}
+
+			SolveStats stats;
+			switch (pressureSolver)
 			{
-				for (int i = 1; i < N - 1; i++)
+			case PressureSolver::multigrid:
+				stats = multigrid.solve(x, b, width, height, 1, 6, pressureTolerance, maxPressureIterations, pool);
+				break;
+			case PressureSolver::conjugate_gradient:
+				stats = conjugateGradient.solve(x, b, width, height, 1, 6, pressureTolerance, maxPressureIterations, pool);
+				break;
+			default:
+				for (int k = 0; k < iter; k++)
 				{
-					div[ix(i, j)] = -0.5f * (velocX[ix(i + 1, j)]
-						- velocX[ix(i - 1, j)]
-						+ velocY[ix(i, j + 1)]
-						- velocY[ix(i, j - 1)]
-						) / N;
-					p[ix(i, j)] = 0;
+					for (int color = 0; color < 2; color++)
+					{
+						pressure::for_rows(pool, height, [&](int rowBegin, int rowEnd)
+						{
+							for (int j = rowBegin; j < rowEnd; j++)
+							{
+								red_black_row<0>(b + j * width, x + j * width, j, color, 1, 1.0f / 6, width, 1, width - 1);
+							}
+						});
+					}
 				}
+				stats = sweep_stats(x, b, width, height);
+				break;
+			}
+
+			for (int j = activeCells.yBegin; j < activeCells.yEnd; j++)
+			{
+				for (auto run : row_runs(j)) std::copy(x + run.begin - left + (j - top) * width, x + run.end - left + (j - top) * width, p + run.begin + j * N);
 			}
+			return stats;
+		}
+
+		void project(T velocX[], T velocY[], float p[], float div[])
+		{
+			with_size([&](auto size)
+			{
+				constexpr int StaticN = decltype(size)::value;
+				for_rows([&](int rowBegin, int rowEnd)
+				{
+					for (int j = rowBegin; j < rowEnd; j++)
+					{
+						for (auto run : row_runs(j)) divergence_row<StaticN>(velocX + j * N, velocY + j * N, div + j * N, p + j * N, N, run.begin, run.end);
+					}
+				});
+			});
 			set_bnd(0, div);
 			set_bnd(0, p);
-			lin_solve(0, p, div, 1, 6);
+			solve_pressure(p, div);
 
-			for (int j = 1; j < N - 1; j++)
+			with_size([&](auto size)
 			{
-				for (int i = 1; i < N - 1; i++)
+				constexpr int StaticN = decltype(size)::value;
+				for_rows([&](int rowBegin, int rowEnd)
 				{
-					velocX[ix(i, j)] -= 0.5f * (p[ix(i + 1, j)] - p[ix(i - 1, j)]) * N;
-					velocY[ix(i, j)] -= 0.5f * (p[ix(i, j + 1)] - p[ix(i, j - 1)]) * N;
-				}
-			}
+					for (int j = rowBegin; j < rowEnd; j++)
+					{
+						for (auto run : row_runs(j)) subtract_gradient_row<StaticN>(p + j * N, velocX + j * N, velocY + j * N, N, run.begin, run.end);
+					}
+				});
+			});
 
 			set_bnd(1, velocX);
-			set_bnd(2, velocX);
+			set_bnd(2, velocY);
+		}
+
+		// float fields are reused as project's scratch, 16-bit ones can't hold it
+		float* project_scratch(std::vector<T>& field, std::vector<float>& scratch)
+		{
+			if constexpr (std::is_same_v<T, float>) return field.data();
+			else return scratch.data();
 		}
 
-		void advect(int b, float d[], float d0[], float velocX[], float velocY[])
+		// backtraces each interior cell along the velocity and samples d0 there, one row at a time through the batched kernels
+		void advect(int b, T d[], T d0[], T velocX[], T velocY[])
+		{
+			T* fields[] = { d };
+			const T* previous[] = { d0 };
+			advect_fields(fields, previous, velocX, velocY);
+		}
+
+		// advect for several fields along the same velocity, each cell is traced once and all the fields sampled there together
+		void advect_fields(std::span<T* const> d, std::span<const T* const> d0, T velocX[], T velocY[])
 		{
-			float i0, i1, j0, j1;
 			float dtx = dt * (N - 2);
 			float dty = dt * (N - 2);
+			size_t fieldCount = d.size();
 
-			float s0, s1, t0, t1;
-			float tmp1, tmp2, x, y;
+			for_rows([&](int rowBegin, int rowEnd)
+			{
+				float* scratch = advectScratch.data() + (pool ? fae::thread_pool::current_thread_index() : 0) * (2 + maxAdvectedFields) * N;
+				float* sampled[maxAdvectedFields];
+				for (int j = rowBegin; j < rowEnd; j++)
+				{
+					for (auto run : row_runs(j))
+					{
+						size_t count = run.end - run.begin;
+						size_t row = run.begin + j * N;
+						std::span<float> x(scratch, count);
+						std::span<float> y(scratch + N, count);
+						for (size_t f = 0; f < fieldCount; f++) sampled[f] = scratch + (2 + f) * N;
+						if constexpr (std::is_same_v<T, float>)
+						{
+							fae::math::scale({ velocX + row, count }, -dtx, x);
+							fae::math::scale({ velocY + row, count }, -dty, y);
+						}
+						else
+						{
+							fae::math::widen({ velocX + row, count }, x);
+							fae::math::scale(x, -dtx, x);
+							fae::math::widen({ velocY + row, count }, y);
+							fae::math::scale(y, -dty, y);
+						}
+						fae::math::add(x, std::span<const float>(advectColumns).subspan(run.begin - 1, count), x);
+						fae::math::clamp(x, 0.5f, N + 0.5f, x);
+						fae::math::add(y, (float)j, y);
+						fae::math::clamp(y, 0.5f, N + 0.5f, y);
+						if constexpr (std::is_same_v<T, float>)
+						{
+							// float fields are sampled straight into their rows
+							for (size_t f = 0; f < fieldCount; f++) sampled[f] = d[f] + row;
+							fae::math::bilinear_sample(d0, N, N, x, y, { sampled, fieldCount });
+						}
+						else
+						{
+							fae::math::bilinear_sample(d0, N, N, x, y, { sampled, fieldCount });
+							for (size_t f = 0; f < fieldCount; f++) fae::math::narrow({ sampled[f], count }, { d[f] + row, count });
+						}
+					}
+				}
+			});
+		}
+
+		template<typename U>
+		void set_bnd(int b, U x[])
+		{
+			auto negate = [](U value) { return fae::math::from_float<U>(-fae::math::to_float(value)); };
+			auto average = [](U a, U b) { return fae::math::from_float<U>(0.5f * (fae::math::to_float(a) + fae::math::to_float(b))); };
+			U* top = x;
+			U* bottom = x + (N - 1) * N;
+			for (int i = 1; i < N - 1; i++)
+			{
+				top[i] = b == 2 ? negate(top[i + N]) : top[i + N];
+				bottom[i] = b == 2 ? negate(bottom[i - N]) : bottom[i - N];
+			}
+			for (int j = 1; j < N - 1; j++)
+			{
+				U* row = x + j * N;
+				row[0] = b == 1 ? negate(row[1]) : row[1];
+				row[N - 1] = b == 1 ? negate(row[N - 2]) : row[N - 2];
+			}
 
-			float Nfloat = N;
-			float ifloat, jfloat;
-			int i, j;
+			top[0] = average(top[1], top[N]);
+			bottom[0] = average(bottom[1], bottom[-N]);
+			top[N - 1] = average(top[N - 2], top[2 * N - 1]);
+			bottom[N - 1] = average(bottom[N - 2], bottom[-1]);
+		}
 
-			for (j = 1, jfloat = 1; j < N - 1; j++, jfloat++)
+		// zeroes the cells of a tile in every field, scratch ones included
+		void clear_tile(int tx, int ty)
+		{
+			int x = tx * tileSize;
+			int width = std::min(tileSize, N - x);
+			auto clear = [&](auto& field)
 			{
-				for (i = 1, ifloat = 1; i < N - 1; i++, ifloat++)
+				if (field.empty()) return;
+				for (int j = ty * tileSize; j < std::min(N, (ty + 1) * tileSize); j++)
 				{
-					tmp1 = dtx * velocX[ix(i, j)];
-					tmp2 = dty * velocY[ix(i, j)];
-					x = ifloat - tmp1;
-					y = jfloat - tmp2;
-
-					if (x < 0.5f) x = 0.5f;
-					if (x > Nfloat + 0.5f) x = Nfloat + 0.5f;
-					i0 = floorf(x);
-					i1 = i0 + 1.0f;
-					if (y < 0.5f) y = 0.5f;
-					if (y > Nfloat + 0.5f) y = Nfloat + 0.5f;
-					j0 = floorf(y);
-					j1 = j0 + 1.0f;
-
-					s1 = x - i0;
-					s0 = 1.0f - s1;
-					t1 = y - j0;
-					t0 = 1.0f - t1;
-
-					int i0i = i0;
-					int i1i = i1;
-					int j0i = j0;
-					int j1i = j1;
-
-					d[ix(i, j)] = s0 * (t0 * d0[ix(i0i, j0i)] + t1 * d0[ix(i0i, j1i)]) + s1 * (t0 * d0[ix(i1i, j0i)] + t1 * d0[ix(i1i, j1i)]);
+					std::fill_n(field.begin() + x + j * N, width, typename std::decay_t<decltype(field)>::value_type{});
 				}
+			};
+			for (auto* field : { &s, &density, &Vx, &Vy, &Vx0, &Vy0 }) clear(*field);
+			for (int c = 0; c < 3; c++)
+			{
+				clear(dye[c]);
+				clear(dye0[c]);
 			}
+			clear(projectPressure);
+			clear(projectDivergence);
 		}
 
-		void set_bnd(int b, float x[])
+		// finds the tiles with something over the threshold, grows them by the halo and rebuilds the runs and the box
+		void update_active_tiles()
 		{
-			for (int i = 1; i < N - 1; i++)
+			// only active tiles and those added to can have anything in them, the rest are known to be zero
+			auto scan = [&](int ty)
 			{
-				x[ix(i, 0)] = b == 2 ? -x[ix(i, 1)] : x[ix(i, 1)];
-				x[ix(i, N - 1)] = b == 2 ? -x[ix(i, N - 2)] : x[ix(i, N - 2)];
+				float speed = 0;
+				for (int tx = 0; tx < tiles; tx++)
+				{
+					int t = tx + ty * tiles;
+					bool live = touchedTiles[t];
+					if (activeTiles[t])
+					{
+						for (int j = ty * tileSize; j < std::min(N, (ty + 1) * tileSize); j++)
+						{
+							for (int i = tx * tileSize; i < std::min(N, (tx + 1) * tileSize); i++)
+							{
+								float velocity = std::max(std::abs(load(Vx[i + j * N])), std::abs(load(Vy[i + j * N])));
+								float amount = std::abs(load(density[i + j * N]));
+								for (int c = 0; c < 3 && hasDye(); c++) amount = std::max(amount, std::abs(load(dye[c][i + j * N])));
+								speed = std::max(speed, velocity);
+								live = live || std::max(velocity, amount) > activityThreshold;
+							}
+						}
+					}
+					liveTiles[t] = live;
+				}
+				tileRowSpeeds[ty] = speed;
+			};
+			if (pool) pool->parallel_for(0, tiles, 1, [&](size_t begin, size_t end) { for (size_t ty = begin; ty < end; ty++) scan((int)ty); });
+			else for (int ty = 0; ty < tiles; ty++) scan(ty);
+
+			// as far as a step can carry anything: advection at the fastest speed, plus two cells per red-black sweep (the black
+			// half reads what the red half just wrote) for each of velocity's three solves, its diffusion and both projections
+			float speed = *std::max_element(tileRowSpeeds.begin(), tileRowSpeeds.end());
+			float reach = speed * dt * (N - 2) + 2 * iter * 3;
+			int halo = 1 + (int)(std::min(reach, (float)N) / tileSize);
+
+			// grow the live tiles by the halo, along rows and then along columns
+			std::vector<uint8_t>& grown = grownTiles;
+			for (int ty = 0; ty < tiles; ty++)
+			{
+				for (int tx = 0; tx < tiles; tx++)
+				{
+					bool any = false;
+					for (int x = std::max(0, tx - halo); x <= std::min(tiles - 1, tx + halo) && !any; x++) any = liveTiles[x + ty * tiles];
+					grown[tx + ty * tiles] = any;
+				}
 			}
-			for (int j = 1; j < N - 1; j++)
+			activeTileCount = 0;
+			for (int ty = 0; ty < tiles; ty++)
 			{
-				x[ix(0, j)] = b == 1 ? -x[ix(1, j)] : x[ix(1, j)];
-				x[ix(N - 1, j)] = b == 1 ? -x[ix(N - 2, j)] : x[ix(N - 2, j)];
+				for (int tx = 0; tx < tiles; tx++)
+				{
+					bool any = false;
+					for (int y = std::max(0, ty - halo); y <= std::min(tiles - 1, ty + halo) && !any; y++) any = grown[tx + y * tiles];
+					int t = tx + ty * tiles;
+					if (activeTiles[t] && !any) clear_tile(tx, ty);
+					activeTiles[t] = any;
+					activeTileCount += any;
+				}
 			}
+			std::fill(touchedTiles.begin(), touchedTiles.end(), 0);
 
-			x[ix(0, 0)] = 0.5 * (x[ix(1, 0)] + x[ix(0, 1)]);
-			x[ix(0, N - 1)] = 0.5f * (x[ix(1, N - 1)] + x[ix(0, N - 2)]);
-			x[ix(N - 1, 0)] = 0.5f * (x[ix(N - 2, 0)] + x[ix(N - 1, 1)]);
-			x[ix(N - 1, N - 1)] = 0.5f * (x[ix(N - 2, N - 1)] + x[ix(N - 1, N - 2)]);
+			activeRuns.clear();
+			activeCells = { N, N, 0, 0 };
+			for (int ty = 0; ty < tiles; ty++)
+			{
+				activeRunOffsets[ty] = (int)activeRuns.size();
+				for (int tx = 0; tx < tiles; tx++)
+				{
+					if (!activeTiles[tx + ty * tiles]) continue;
+					int first = tx;
+					while (tx + 1 < tiles && activeTiles[tx + 1 + ty * tiles]) tx++;
+					Span run = { std::max(1, first * tileSize), std::min(N - 1, (tx + 1) * tileSize) };
+					if (run.begin >= run.end) continue;
+					activeRuns.push_back(run);
+					activeCells.xBegin = std::min(activeCells.xBegin, run.begin);
+					activeCells.xEnd = std::max(activeCells.xEnd, run.end);
+					activeCells.yBegin = std::min(activeCells.yBegin, std::max(1, ty * tileSize));
+					activeCells.yEnd = std::max(activeCells.yEnd, std::min(N - 1, (ty + 1) * tileSize));
+				}
+			}
+			activeRunOffsets[tiles] = (int)activeRuns.size();
+			if (activeRuns.empty()) activeCells = {};
 		}
 
 		void step()
 		{
+			fae::math::flush_denormals flush;
+			advectScratch.resize((2 + maxAdvectedFields) * N * (pool ? pool->size() + 1 : 1));
+			pressureStats = {};
+			if (sparse) update_active_tiles();
+			else if (activeTileCount < tiles * tiles)
+			{
+				// whatever is in the inactive tiles is zero, so a later sparse step can start from all of them again
+				std::fill(activeTiles.begin(), activeTiles.end(), 1);
+				activeTileCount = tiles * tiles;
+			}
+
 			diffuse(1, Vx0.data(), Vx.data(), visc);
 			diffuse(2, Vy0.data(), Vy.data(), visc);
 
-			project(Vx0.data(), Vy0.data(), Vx.data(), Vy.data());
+			project(Vx0.data(), Vy0.data(), project_scratch(Vx, projectPressure), project_scratch(Vy, projectDivergence));
+
+			if (fusedAdvection)
+			{
+				diffuse(0, s.data(), density.data(), diff);
+				T* fields[maxAdvectedFields] = { Vx.data(), Vy.data(), density.data() };
+				const T* previous[maxAdvectedFields] = { Vx0.data(), Vy0.data(), s.data() };
+				size_t fieldCount = 3;
+				for (int c = 0; c < 3 && hasDye(); c++, fieldCount++)
+				{
+					diffuse(0, dye0[c].data(), dye[c].data(), diff);
+					fields[fieldCount] = dye[c].data();
+					previous[fieldCount] = dye0[c].data();
+				}
+				advect_fields({ fields, fieldCount }, { previous, fieldCount }, Vx0.data(), Vy0.data());
+
+				project(Vx.data(), Vy.data(), project_scratch(Vx0, projectPressure), project_scratch(Vy0, projectDivergence));
+				return;
+			}
 
 			advect(1, Vx.data(), Vx0.data(), Vx0.data(), Vy0.data());
 			advect(2, Vy.data(), Vy0.data(), Vx0.data(), Vy0.data());
 
-			project(Vx.data(), Vy.data(), Vx0.data(), Vy0.data());
+			project(Vx.data(), Vy.data(), project_scratch(Vx0, projectPressure), project_scratch(Vy0, projectDivergence));
 
 			diffuse(0, s.data(), density.data(), diff);
 			advect(0, density.data(), s.data(), Vx.data(), Vy.data());
+			for (int c = 0; c < 3 && hasDye(); c++)
+			{
+				diffuse(0, dye0[c].data(), dye[c].data(), diff);
+				advect(0, dye[c].data(), dye0[c].data(), Vx.data(), Vy.data());
+			}
 		}
 
-		void renderD()
+		// white with density as alpha, or tinted by dye when it isn't empty (as filled by copyDye)
+		static void renderD(const std::vector<float>& density, const std::vector<float>& dye, int N, fae::PixelGrid& pixels, fae::CellRange cells)
 		{
-			for (int i = 0; i < N; i++)
+			size_t plane = (size_t)N * N;
+			for (int j = cells.yBegin; j < cells.yEnd; j++)
 			{
-				for (int j = 0; j < N; j++)
+				for (int i = cells.xBegin; i < cells.xEnd; i++)
 				{
-					float x = i * SCALE;
-					float y = j * SCALE;
-					float d = density[ix(i, j)];
+					float d = density[i + j * N];
 					Color c = WHITE;
-					c.a = d * 255;
-					DrawRectangle(x, y, SCALE, SCALE, c);
+					c.a = Clamp(d, 0, 1) * 255;
+					if (!dye.empty())
+					{
+						c.r = Clamp(dye[i + j * N], 0, 1) * 255;
+						c.g = Clamp(dye[plane + i + j * N], 0, 1) * 255;
+						c.b = Clamp(dye[2 * plane + i + j * N], 0, 1) * 255;
+					}
+					pixels.At(i, j) = c;
 				}
 			}
 		}
 	};
 
-	Fluid f = Fluid(0, 0);
-	Vector2 prevMouse;
+	using Fluid = BasicFluid<float>;
+	using Bf16Fluid = BasicFluid<fae::math::bfloat16>;
+
+	// mouse input collected on the main thread, applied by the simulation thread before its next step
+	struct Injection
+	{
+		Vector2 cell;
+		float density;
+		Vector2 velocity;
+		Vector3 dye;
+	};
+
+	// what the simulation thread publishes after each step
+	struct Snapshot
+	{
+		std::vector<float> density;
+		// empty without dye
+		std::vector<float> dye;
+		PressureSolver solver;
+		SolveStats pressure;
+		// out of tiles * tiles
+		int activeTiles = 0;
+		int tiles = 0;
+		// tracer particles splatted at tracerResolution pixels per cell, empty without them
+		std::vector<Color> tracers;
+		// the frame shown when replaying, -1 otherwise
+		int replayFrame = -1;
+		bool replayPaused = false;
+	};
+
+	Descriptor descriptor;
+
+	// only touched by the simulation thread, except through injections, requestedSolver and snapshots
+	std::variant<Fluid, Bf16Fluid> f = Fluid(0, 0);
+	std::mutex injectionsMutex;
+	std::vector<Injection> injections;
+	std::vector<Injection> stepInjections;
+	PressureSolver requestedSolver = PressureSolver::gauss_seidel;
+	// frames to move the replay by and whether it's advancing on its own, guarded by injectionsMutex too
+	int replaySeek = 0;
+	bool replayPaused = false;
+	FluidRecorder recorder;
+	FluidReplay replay;
+	// advanced before it's read, so the first step shows frame 0
+	int replayFrame = -1;
+	std::vector<float> recordedVelocX, recordedVelocY;
+	// density is sized by the first step to fill each slot
+	fae::triple_buffer<Snapshot> snapshots;
+
+	fae::PixelGrid pixels;
+	FluidTracers tracers;
+	// no finer than a screen pixel at the descriptor's scale, at most 2048 tracer pixels a side
+	int tracerResolution = 1;
+	fae::PixelGrid tracerPixels;
+	Camera2D camera = { { 0, 0 }, { 0, 0 }, 0, 1 };
+
+	// headless default: drag in a circle around the middle of the grid with the button held
+	static void headless_script(size_t frame, fae::Input& input, float extent)
+	{
+		float angle = frame * 0.05f;
+		float radius = extent * 0.25f;
+		input.mousePosition = { extent * 0.5f + cosf(angle) * radius, extent * 0.5f + sinf(angle) * radius };
+		input.mouseDown[MOUSE_BUTTON_LEFT] = true;
+	}
 
 	void setup(fluid& app, entt::registry& reg)
 	{
 		auto& renderer = reg.ctx().at<fae::Renderer>();
 		renderer.clearColor = BLACK;
+		if (auto descriptor = reg.ctx().find<Descriptor>()) app.descriptor = *descriptor;
+		if (!app.descriptor.replayPath.empty())
+		{
+			if (app.replay.open(app.descriptor.replayPath)) app.descriptor.size = app.replay.size();
+			else TraceLog(LOG_WARNING, "FLUID: could not replay %s, simulating instead", app.descriptor.replayPath.c_str());
+		}
+		int N = app.descriptor.size;
+		if (app.descriptor.bfloat16) app.f.emplace<Bf16Fluid>(0.f, 0.f, N);
+		else app.f.emplace<Fluid>(0.f, 0.f, N);
+		std::visit([&](auto& f)
+		{
+			f.iter = app.descriptor.iterations;
+			f.dt = app.descriptor.dt;
+			f.fusedAdvection = app.descriptor.fusedAdvection;
+			f.sparse = app.descriptor.sparse;
+			if (app.descriptor.dye) f.enableDye();
+			f.pool = &reg.ctx().at<fae::application&>().scheduler.pool();
+		}, app.f);
+		if (!app.replay.is_open() && !app.descriptor.recordPath.empty())
+		{
+			app.recorder.encoding = app.descriptor.recordEncoding;
+			app.recorder.open(app.descriptor.recordPath, N);
+		}
+		app.pixels.Resize(N, N);
+		if (app.descriptor.tracers)
+		{
+			app.tracers.seed(app.descriptor.tracers, N);
+			app.tracerResolution = std::clamp(app.descriptor.scale, 1, std::max(1, 2048 / N));
+			app.tracerPixels.Resize(N * app.tracerResolution, N * app.tracerResolution);
+		}
+		reg.ctx().at<fae::ActiveCamera2D>().camera = &app.camera;
+		if (auto headless = reg.ctx().find<fae::HeadlessDescriptor>(); headless && !headless->script)
+		{
+			float extent = float(N * app.descriptor.scale);
+			headless->script = [extent](size_t frame, fae::Input& input) { headless_script(frame, input, extent); };
+		}
 	}
 
 
 	void update(fluid& app, entt::registry& reg)
 	{
-		if (IsMouseButtonDown(MOUSE_BUTTON_LEFT))
+		auto& input = reg.ctx().at<fae::Input>();
+		if (input.IsKeyPressed(KEY_P))
+		{
+			std::scoped_lock lock(app.injectionsMutex);
+			app.requestedSolver = PressureSolver(((int)app.requestedSolver + 1) % 3);
+		}
+		if (app.replay.is_open())
+		{
+			// space pauses, the arrows step a frame or a second of frames with shift
+			int seek = input.IsKeyDown(KEY_LEFT_SHIFT) ? 60 : 1;
+			std::scoped_lock lock(app.injectionsMutex);
+			if (input.IsKeyPressed(KEY_SPACE)) app.replayPaused = !app.replayPaused;
+			if (input.IsKeyPressed(KEY_RIGHT)) app.replaySeek += seek;
+			if (input.IsKeyPressed(KEY_LEFT)) app.replaySeek -= seek;
+			return;
+		}
+		if (input.IsMouseButtonDown(MOUSE_BUTTON_LEFT))
+		{
+			auto mouse = fae::screen_to_world(reg, input.mousePosition);
+			Vector2 cell = { mouse.x / app.descriptor.scale, mouse.y / app.descriptor.scale };
+			// the hue goes around every 6 seconds
+			Color color = ColorFromHSV(fmodf((float)reg.ctx().at<fae::Time>().elapsed * 60.f, 360.f), 1, 1);
+			Vector3 dye = { color.r * 100.f / 255.f, color.g * 100.f / 255.f, color.b * 100.f / 255.f };
+			std::scoped_lock lock(app.injectionsMutex);
+			app.injections.push_back({ cell, 100.f, input.mouseDelta, dye });
+		}
+	}
+
+	// fixedUpdate in place of simulate when replaying, a frame of the recording per step
+	void step_replay(fluid& app, entt::registry& reg)
+	{
+		bool paused;
+		{
+			std::scoped_lock lock(app.injectionsMutex);
+			paused = app.replayPaused;
+			app.replayFrame += app.replaySeek + !paused;
+			app.replaySeek = 0;
+		}
+		int frames = (int)app.replay.frame_count();
+		if (frames == 0) return;
+		// loops at either end
+		app.replayFrame = ((app.replayFrame % frames) + frames) % frames;
+
+		auto& snapshot = app.snapshots.write_buffer();
+		{
+			fae::profile_zone zone(reg, "FluidReplay::read");
+			if (!app.replay.read(app.replayFrame, snapshot.density, app.recordedVelocX, app.recordedVelocY)) return;
+		}
+		snapshot.dye.clear();
+		snapshot.replayFrame = app.replayFrame;
+		snapshot.replayPaused = paused;
+		app.snapshots.publish();
+	}
+
+	// fixedUpdate, runs on the simulation thread
+	void simulate(fluid& app, entt::registry& reg)
+	{
+		if (app.replay.is_open())
+		{
+			step_replay(app, reg);
+			return;
+		}
+		PressureSolver solver;
 		{
-			app.f.addDensity({ (float)GetMouseX() / SCALE, (float)GetMouseY() / SCALE }, 100.f);
-			float amtX = GetMouseX() - app.prevMouse.x;
-			float amtY = GetMouseY() - app.prevMouse.y;
-			app.f.addVelocity({ (float)GetMouseX() / SCALE, (float)GetMouseY() / SCALE }, { amtX, amtY });
+			std::scoped_lock lock(app.injectionsMutex);
+			std::swap(app.injections, app.stepInjections);
+			solver = app.requestedSolver;
 		}
-		app.f.step();
-		app.prevMouse = GetMousePosition();
+		std::visit([&](auto& f)
+		{
+			f.pressureSolver = solver;
+			for (auto& injection : app.stepInjections)
+			{
+				f.addDensity(injection.cell, injection.density);
+				f.addVelocity(injection.cell, injection.velocity);
+				f.addDye(injection.cell, injection.dye);
+			}
+
+			{
+				fae::profile_zone zone(reg, "Fluid::step");
+				f.step();
+			}
+
+			auto& snapshot = app.snapshots.write_buffer();
+			f.copyDensity(snapshot.density);
+			f.copyDye(snapshot.dye);
+			snapshot.solver = f.pressureSolver;
+			snapshot.pressure = f.pressureStats;
+			snapshot.activeTiles = f.activeTileCount;
+			snapshot.tiles = f.tiles * f.tiles;
+
+			if (app.tracers.count())
+			{
+				fae::profile_zone zone(reg, "FluidTracers::advect");
+				app.tracers.advect(f.Vx.data(), f.Vy.data(), f.N, f.dt, f.pool);
+				app.tracers.splat(snapshot.tracers, app.tracerPixels.width, app.tracerPixels.height, (float)app.tracerResolution, f.pool);
+			}
+
+			if (app.recorder.is_open())
+			{
+				f.copyVelocity(app.recordedVelocX, app.recordedVelocY);
+				app.recorder.record(snapshot.density, app.recordedVelocX, app.recordedVelocY);
+			}
+		}, app.f);
+		app.stepInjections.clear();
+		app.snapshots.publish();
+	}
+
+	void rasterize(fluid& app, entt::registry& reg)
+	{
+		// the latest snapshot is rasterized even when it isn't new, cells scrolled into view need it too
+		bool fresh = app.snapshots.consume();
+		auto& snapshot = app.snapshots.read_buffer();
+		if (fresh && snapshot.tracers.size() == app.tracerPixels.pixels.size()) std::copy(snapshot.tracers.begin(), snapshot.tracers.end(), app.tracerPixels.pixels.begin());
+		int N = app.descriptor.size;
+		if (snapshot.density.size() != size_t(N * N)) return;
+		auto cells = fae::visible_cells(reg, { 0, 0 }, app.descriptor.scale, N, N);
+		Fluid::renderD(snapshot.density, snapshot.dye, N, app.pixels, cells);
 	}
 
 	void draw(fluid& app, entt::registry& reg)
 	{
-		app.f.renderD();
+		int N = app.descriptor.size;
+		float scale = app.descriptor.scale;
+		fae::draw_pixel_grid(app.pixels, { 0, 0 }, scale, fae::visible_cells(reg, { 0, 0 }, scale, N, N));
+		if (app.tracers.count())
+		{
+			int size = app.tracerPixels.width;
+			float tracerScale = scale / app.tracerResolution;
+			fae::draw_pixel_grid(app.tracerPixels, { 0, 0 }, tracerScale, fae::visible_cells(reg, { 0, 0 }, tracerScale, size, size));
+		}
+	}
+
+	// screen space, drawn in postRender after the camera plugin's end_camera2d
+	void draw_solver_stats(fluid& app, entt::registry& reg)
+	{
+		auto& snapshot = app.snapshots.read_buffer();
+		if (snapshot.replayFrame >= 0)
+		{
+			DrawText(TextFormat("replay: frame %d / %u%s (SPACE, LEFT, RIGHT)", snapshot.replayFrame, app.replay.frame_count(), snapshot.replayPaused ? ", paused" : ""),
+				8, GetScreenHeight() - 18, 10, GREEN);
+			return;
+		}
+		DrawText(TextFormat("pressure: %s (P), %d iterations, residual %.2e", pressure_solver_name(snapshot.solver), snapshot.pressure.iterations, snapshot.pressure.residual),
+			8, GetScreenHeight() - 18, 10, GREEN);
+		if (app.descriptor.sparse) DrawText(TextFormat("active tiles: %d / %d", snapshot.activeTiles, snapshot.tiles), 8, GetScreenHeight() - 32, 10, GREEN);
+	}
+
+	// emplaced after the camera plugin, so its postRender systems come after end_camera2d like the profiler overlay
+	static void overlay_plugin(const void*, entt::registry& reg)
+	{
+		auto& app = static_cast<fluid&>(reg.ctx().at<fae::application&>());
+		app.systems.postRender.emplace<&fluid::draw_solver_stats, const fluid, const Snapshot, fae::main_thread>(app);
+	}
+
+	void cleanup(fluid& app, entt::registry& reg)
+	{
+		app.recorder.close();
+		fae::export_headless_snapshot(reg, app.pixels);
+		fae::unload_pixel_grid(app.pixels);
+		fae::unload_pixel_grid(app.tracerPixels);
 	}
 
 	fluid()
 	{
 		registry.ctx().emplace<fae::WindowDescriptor>("Euler Fluid Simulation");
+		registry.ctx().emplace<fae::FixedTimestep>().threaded = true;
+		registry.ctx().emplace<fae::Camera2DController>();
+		scheduler.mode = fae::scheduler::execution_mode::parallel;
 		plugins.emplace(fae::rendering_plugin);
+		plugins.emplace(fae::time_plugin);
+		plugins.emplace(fae::input_plugin);
+		plugins.emplace(fae::camera2d_plugin);
+		plugins.emplace(fae::profiler_plugin);
+		plugins.emplace(overlay_plugin);
 		systems.start.emplace<&fluid::setup>(*this);
-		systems.update_controlled_gameobject.emplace < &fluid::update>(*this);
-		systems.update_controlled_gameobject.emplace < &fluid::draw>(*this);
+		// the app is shared read only and the state each system writes is a resource of its own, so update and rasterize run side by side.
+		// Injection stands for everything behind injectionsMutex, Snapshot for the read side of snapshots
+		systems.update_controlled_gameobject.emplace<&fluid::update, const fluid, const fae::Input, const fae::Time, const fae::ActiveCamera2D, Injection>(*this);
+		systems.fixedUpdate.emplace<&fluid::simulate>(*this);
+		systems.update_controlled_gameobject.emplace<&fluid::rasterize, const fluid, Snapshot, fae::PixelGrid, const fae::VisibleRegion>(*this);
+		systems.render.emplace<&fluid::draw, const fluid, const fae::PixelGrid, const fae::VisibleRegion, fae::main_thread>(*this);
+		systems.stop.emplace<&fluid::cleanup, fae::main_thread>(*this);
 	}
 };
\ No newline at end of file
@@ -0,0 +1,544 @@
+#pragma once
+#include "../fae/fae.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <span>
+// same stable fluids as fluid.h in three dimensions, reference https://mikeash.com/pyblog/fluid-simulation-for-dummies.html
+struct fluid3d : public fae::application
+{
+	// what ends up in the pixel grid, one z slice of the density or the most of it along z
+	enum class View
+	{
+		slice,
+		max_intensity,
+	};
+
+	// command line settings, read once by setup
+	struct Descriptor
+	{
+		// cells per side along x and y, and along z (the same as size when 0), boundary layers included
+		int size = 64;
+		int depth = 0;
+		// for both, eight float fields of 256^3 cells are already 512 MiB
+		static constexpr int maxSize = 256;
+		// pixels per cell
+		int scale = 8;
+		// gauss-seidel sweeps per linear solve
+		int iterations = 4;
+		// simulation time per step
+		float dt = 0.1f;
+		View view = View::slice;
+	};
+
+	/// <summary>
+	/// Reads --size N [--depth N] [--scale pixels] [--iterations sweeps] [--timestep dt] [--mip] from the command line.
+	/// </summary>
+	static void configure(entt::registry& reg, int argc, char** argv)
+	{
+		Descriptor descriptor;
+		for (int i = 1; i < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) descriptor.size = std::clamp(std::atoi(argv[++i]), 4, Descriptor::maxSize);
+			else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc) descriptor.depth = std::clamp(std::atoi(argv[++i]), 4, Descriptor::maxSize);
+			else if (std::strcmp(argv[i], "--scale") == 0 && i + 1 < argc) descriptor.scale = std::max(1, std::atoi(argv[++i]));
+			else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) descriptor.iterations = std::max(1, std::atoi(argv[++i]));
+			else if (std::strcmp(argv[i], "--timestep") == 0 && i + 1 < argc) descriptor.dt = std::strtof(argv[++i], nullptr);
+			else if (std::strcmp(argv[i], "--mip") == 0) descriptor.view = View::max_intensity;
+		}
+		reg.ctx().emplace<Descriptor>(descriptor);
+	}
+
+	static const char* view_name(View view)
+	{
+		return view == View::max_intensity ? "max intensity" : "slice";
+	}
+
+	/// <summary>
+	/// Stable fluids on an Nx x Ny x Nz grid, x fastest, then y, then z. Cells are cubes sized by Nx like fluid::Fluid's are by N.
+	/// Every stage walks the interior in z slabs over the pool, and each slab in blocks of blockRows rows along y, sweeping
+	/// the whole slab for one block before moving to the next, so the three planes of a block the stencils read stay in cache.
+	/// </summary>
+	struct Volume
+	{
+		int Nx = 64;
+		int Ny = 64;
+		int Nz = 64;
+		int iter = 4;
+		float dt = 0.1f;
+		float diff = 0;
+		float visc = 0;
+
+		std::vector<float> s;
+		std::vector<float> density;
+		std::vector<float> Vx;
+		std::vector<float> Vy;
+		std::vector<float> Vz;
+		std::vector<float> Vx0;
+		std::vector<float> Vy0;
+		std::vector<float> Vz0;
+
+		// every stage is split in z slabs over this pool when set, the result is the same with or without it
+		fae::thread_pool* pool = nullptr;
+		// 32 rows of a 128 wide grid are 16KB a plane. Only pays off once three whole planes of the fields a stencil reads
+		// outgrow the cache, at 128^3 and below it's about even with sweeping whole planes
+		int blockRows = 32;
+
+		Volume(float diff, float visc, int nx, int ny, int nz) : Nx(nx), Ny(ny), Nz(nz), diff(diff), visc(visc)
+		{
+			for (auto* field : { &s, &density, &Vx, &Vy, &Vz, &Vx0, &Vy0, &Vz0 }) field->resize(cells());
+		}
+
+		size_t plane() const { return (size_t)Nx * Ny; }
+		size_t cells() const { return plane() * Nz; }
+
+		size_t ix(int x, int y, int z) const
+		{
+			x = Clamp(x, 0, Nx - 1);
+			y = Clamp(y, 0, Ny - 1);
+			z = Clamp(z, 0, Nz - 1);
+			return x + y * Nx + z * plane();
+		}
+
+		void addDensity(Vector3 i, float amount)
+		{
+			density[ix(i.x, i.y, i.z)] += amount;
+		}
+
+		void addVelocity(Vector3 i, Vector3 amount)
+		{
+			size_t cell = ix(i.x, i.y, i.z);
+			Vx[cell] += amount.x;
+			Vy[cell] += amount.y;
+			Vz[cell] += amount.z;
+		}
+
+		// interior planes [1, Nz - 1), in slabs over the pool when there is one. Returning is the barrier between stages.
+		// Denormals are flushed on the workers as on the thread calling step
+		template<typename Fn>
+		void for_slabs(Fn&& fn)
+		{
+			if (!pool) return fn(1, Nz - 1);
+			int grain = std::max(2, Nz / int(4 * (pool->size() + 1)));
+			pool->parallel_for(1, Nz - 1, grain, [&](size_t slabBegin, size_t slabEnd)
+			{
+				fae::math::flush_denormals flush;
+				fn((int)slabBegin, (int)slabEnd);
+			});
+		}
+
+		// fn(j, k) for every interior row, slab by slab and block by block within a slab
+		template<typename Fn>
+		void for_rows(Fn&& fn)
+		{
+			for_slabs([&](int slabBegin, int slabEnd)
+			{
+				for (int blockBegin = 1; blockBegin < Ny - 1; blockBegin += blockRows)
+				{
+					int blockEnd = std::min(Ny - 1, blockBegin + blockRows);
+					for (int k = slabBegin; k < slabEnd; k++)
+					{
+						for (int j = blockBegin; j < blockEnd; j++) fn(j, k);
+					}
+				}
+			});
+		}
+
+		size_t row(int j, int k) const { return j * Nx + k * plane(); }
+
+		void diffuse(int b, float x[], float x0[], float diff)
+		{
+			float a = dt * diff * (Nx - 2) * (Nx - 2);
+			lin_solve(b, x, x0, a, 1 + 6 * a);
+		}
+
+		// red-black gauss-seidel, cells with (i + j + k) % 2 == color only have neighbors of the other color
+		void lin_solve(int b, float x[], const float x0[], float a, float c)
+		{
+			float cRecip = 1.0f / c;
+			size_t stride = Nx;
+			size_t depth = plane();
+			for (int sweep = 0; sweep < iter; sweep++)
+			{
+				for (int color = 0; color < 2; color++)
+				{
+					for_rows([&](int j, int k)
+					{
+						float* cells = x + row(j, k);
+						const float* previous = x0 + row(j, k);
+						for (int i = 1 + ((1 + j + k + color) & 1); i < Nx - 1; i += 2)
+						{
+							float neighbors = cells[i + 1] + cells[i - 1] + cells[i + stride] + cells[i - stride] + cells[i + depth] + cells[i - depth];
+							cells[i] = (previous[i] + a * neighbors) * cRecip;
+						}
+					});
+				}
+			}
+			set_bnd(b, x);
+		}
+
+		void project(float velocX[], float velocY[], float velocZ[], float p[], float div[])
+		{
+			size_t stride = Nx;
+			size_t depth = plane();
+			for_rows([&](int j, int k)
+			{
+				size_t r = row(j, k);
+				for (int i = 1; i < Nx - 1; i++)
+				{
+					size_t c = r + i;
+					div[c] = -0.5f * (velocX[c + 1] - velocX[c - 1] + velocY[c + stride] - velocY[c - stride] + velocZ[c + depth] - velocZ[c - depth]) / Nx;
+					p[c] = 0;
+				}
+			});
+			set_bnd(0, div);
+			set_bnd(0, p);
+			lin_solve(0, p, div, 1, 6);
+
+			for_rows([&](int j, int k)
+			{
+				size_t r = row(j, k);
+				for (int i = 1; i < Nx - 1; i++)
+				{
+					size_t c = r + i;
+					velocX[c] -= 0.5f * (p[c + 1] - p[c - 1]) * Nx;
+					velocY[c] -= 0.5f * (p[c + stride] - p[c - stride]) * Nx;
+					velocZ[c] -= 0.5f * (p[c + depth] - p[c - depth]) * Nx;
+				}
+			});
+			set_bnd(1, velocX);
+			set_bnd(2, velocY);
+			set_bnd(3, velocZ);
+		}
+
+		// traces each interior cell back along the velocity and samples every field of d0 there trilinearly,
+		// the corners and weights are worked out once for all of them
+		void advect(std::span<float* const> d, std::span<const float* const> d0, const float velocX[], const float velocY[], const float velocZ[])
+		{
+			float dt0 = dt * (Nx - 2);
+			size_t stride = Nx;
+			size_t depth = plane();
+			for_rows([&](int j, int k)
+			{
+				size_t r = row(j, k);
+				for (int i = 1; i < Nx - 1; i++)
+				{
+					float x = Clamp(i - dt0 * velocX[r + i], 0.5f, Nx - 1.5f);
+					float y = Clamp(j - dt0 * velocY[r + i], 0.5f, Ny - 1.5f);
+					float z = Clamp(k - dt0 * velocZ[r + i], 0.5f, Nz - 1.5f);
+					int i0 = (int)x;
+					int j0 = (int)y;
+					int k0 = (int)z;
+					float s1 = x - i0;
+					float t1 = y - j0;
+					float u1 = z - k0;
+					float s0 = 1 - s1;
+					float t0 = 1 - t1;
+					float u0 = 1 - u1;
+					size_t c = i0 + j0 * stride + k0 * depth;
+					for (size_t f = 0; f < d.size(); f++)
+					{
+						const float* src = d0[f] + c;
+						d[f][r + i] =
+							s0 * (t0 * (u0 * src[0] + u1 * src[depth]) + t1 * (u0 * src[stride] + u1 * src[stride + depth])) +
+							s1 * (t0 * (u0 * src[1] + u1 * src[1 + depth]) + t1 * (u0 * src[1 + stride] + u1 * src[1 + stride + depth]));
+					}
+				}
+			});
+		}
+
+		// b is the axis the field is a velocity component along (1 x, 2 y, 3 z), its walls across that axis are mirrored.
+		// Edges average the two face cells next to them and corners the three edge cells
+		void set_bnd(int b, float x[])
+		{
+			for (int k = 1; k < Nz - 1; k++)
+			{
+				for (int j = 1; j < Ny - 1; j++)
+				{
+					x[ix(0, j, k)] = b == 1 ? -x[ix(1, j, k)] : x[ix(1, j, k)];
+					x[ix(Nx - 1, j, k)] = b == 1 ? -x[ix(Nx - 2, j, k)] : x[ix(Nx - 2, j, k)];
+				}
+				for (int i = 1; i < Nx - 1; i++)
+				{
+					x[ix(i, 0, k)] = b == 2 ? -x[ix(i, 1, k)] : x[ix(i, 1, k)];
+					x[ix(i, Ny - 1, k)] = b == 2 ? -x[ix(i, Ny - 2, k)] : x[ix(i, Ny - 2, k)];
+				}
+			}
+			for (int j = 1; j < Ny - 1; j++)
+			{
+				for (int i = 1; i < Nx - 1; i++)
+				{
+					x[ix(i, j, 0)] = b == 3 ? -x[ix(i, j, 1)] : x[ix(i, j, 1)];
+					x[ix(i, j, Nz - 1)] = b == 3 ? -x[ix(i, j, Nz - 2)] : x[ix(i, j, Nz - 2)];
+				}
+			}
+
+			auto inward = [](int v, int n) { return v == 0 ? 1 : v == n - 1 ? n - 2 : v; };
+			auto average = [&](int i, int j, int k)
+			{
+				bool walls[] = { i == 0 || i == Nx - 1, j == 0 || j == Ny - 1, k == 0 || k == Nz - 1 };
+				float sum = 0;
+				if (walls[0]) sum += x[ix(inward(i, Nx), j, k)];
+				if (walls[1]) sum += x[ix(i, inward(j, Ny), k)];
+				if (walls[2]) sum += x[ix(i, j, inward(k, Nz))];
+				x[ix(i, j, k)] = sum / (walls[0] + walls[1] + walls[2]);
+			};
+			for (int j : { 0, Ny - 1 })
+			{
+				for (int k : { 0, Nz - 1 })
+				{
+					for (int i = 1; i < Nx - 1; i++) average(i, j, k);
+				}
+			}
+			for (int i : { 0, Nx - 1 })
+			{
+				for (int k : { 0, Nz - 1 })
+				{
+					for (int j = 1; j < Ny - 1; j++) average(i, j, k);
+				}
+				for (int j : { 0, Ny - 1 })
+				{
+					for (int k = 1; k < Nz - 1; k++) average(i, j, k);
+				}
+			}
+			for (int i : { 0, Nx - 1 })
+			{
+				for (int j : { 0, Ny - 1 })
+				{
+					for (int k : { 0, Nz - 1 }) average(i, j, k);
+				}
+			}
+		}
+
+		void step()
+		{
+			fae::math::flush_denormals flush;
+			diffuse(1, Vx0.data(), Vx.data(), visc);
+			diffuse(2, Vy0.data(), Vy.data(), visc);
+			diffuse(3, Vz0.data(), Vz.data(), visc);
+
+			project(Vx0.data(), Vy0.data(), Vz0.data(), Vx.data(), Vy.data());
+
+			float* velocity[] = { Vx.data(), Vy.data(), Vz.data() };
+			const float* previous[] = { Vx0.data(), Vy0.data(), Vz0.data() };
+			advect(velocity, previous, Vx0.data(), Vy0.data(), Vz0.data());
+			set_bnd(1, Vx.data());
+			set_bnd(2, Vy.data());
+			set_bnd(3, Vz.data());
+
+			project(Vx.data(), Vy.data(), Vz.data(), Vx0.data(), Vy0.data());
+
+			diffuse(0, s.data(), density.data(), diff);
+			float* fields[] = { density.data() };
+			const float* sources[] = { s.data() };
+			advect(fields, sources, Vx.data(), Vy.data(), Vz.data());
+			set_bnd(0, density.data());
+		}
+
+		// an Nx x Ny image of the density, plane z of it or its maximum along z, out is resized to fit
+		void render_view(View view, int z, std::vector<float>& out)
+		{
+			out.resize(plane());
+			if (view == View::slice)
+			{
+				z = Clamp(z, 0, Nz - 1);
+				std::copy_n(density.begin() + z * plane(), plane(), out.begin());
+				return;
+			}
+
+			auto rows = [&](int rowBegin, int rowEnd)
+			{
+				for (int j = rowBegin; j < rowEnd; j++)
+				{
+					float* image = out.data() + j * Nx;
+					std::copy_n(density.begin() + j * Nx, Nx, image);
+					for (int k = 1; k < Nz; k++)
+					{
+						const float* cells = density.data() + row(j, k);
+						for (int i = 0; i < Nx; i++) image[i] = std::max(image[i], cells[i]);
+					}
+				}
+			};
+			if (!pool) return rows(0, Ny);
+			pool->parallel_for(0, Ny, std::max(4, Ny / int(4 * (pool->size() + 1))), [&](size_t rowBegin, size_t rowEnd) { rows((int)rowBegin, (int)rowEnd); });
+		}
+	};
+
+	// mouse input collected on the main thread, applied by the simulation thread before its next step
+	struct Injection
+	{
+		Vector3 cell;
+		float density;
+		Vector3 velocity;
+	};
+
+	// what the simulation thread publishes after each step
+	struct Snapshot
+	{
+		// Nx x Ny
+		std::vector<float> image;
+		View view = View::slice;
+		int slice = 0;
+	};
+
+	Descriptor descriptor;
+
+	// only touched by the simulation thread, except through injections, the requested view and snapshots
+	Volume f = Volume(0, 0, 4, 4, 4);
+	std::mutex injectionsMutex;
+	std::vector<Injection> injections;
+	std::vector<Injection> stepInjections;
+	View requestedView = View::slice;
+	int requestedSlice = 0;
+	fae::triple_buffer<Snapshot> snapshots;
+
+	fae::PixelGrid pixels;
+	Camera2D camera = { { 0, 0 }, { 0, 0 }, 0, 1 };
+
+	// headless default: drag in a circle around the middle of the grid with the button held
+	static void headless_script(size_t frame, fae::Input& input, Vector2 extent)
+	{
+		float angle = frame * 0.05f;
+		float radius = std::min(extent.x, extent.y) * 0.25f;
+		input.mousePosition = { extent.x * 0.5f + cosf(angle) * radius, extent.y * 0.5f + sinf(angle) * radius };
+		input.mouseDown[MOUSE_BUTTON_LEFT] = true;
+	}
+
+	void setup(fluid3d& app, entt::registry& reg)
+	{
+		auto& renderer = reg.ctx().at<fae::Renderer>();
+		renderer.clearColor = BLACK;
+		if (auto descriptor = reg.ctx().find<Descriptor>()) app.descriptor = *descriptor;
+		int N = app.descriptor.size;
+		if (!app.descriptor.depth) app.descriptor.depth = N;
+		int depth = app.descriptor.depth;
+		app.f = Volume(0, 0, N, N, depth);
+		app.f.iter = app.descriptor.iterations;
+		app.f.dt = app.descriptor.dt;
+		app.f.pool = &reg.ctx().at<fae::application&>().scheduler.pool();
+		app.requestedView = app.descriptor.view;
+		app.requestedSlice = depth / 2;
+		app.pixels.Resize(N, N);
+		reg.ctx().at<fae::ActiveCamera2D>().camera = &app.camera;
+		if (auto headless = reg.ctx().find<fae::HeadlessDescriptor>(); headless && !headless->script)
+		{
+			Vector2 extent = { float(N * app.descriptor.scale), float(N * app.descriptor.scale) };
+			headless->script = [extent](size_t frame, fae::Input& input) { headless_script(frame, input, extent); };
+		}
+	}
+
+	// V switches between the slice and the projection, up and down move the slice, injections go into it
+	void update(fluid3d& app, entt::registry& reg)
+	{
+		auto& input = reg.ctx().at<fae::Input>();
+		std::scoped_lock lock(app.injectionsMutex);
+		if (input.IsKeyPressed(KEY_V)) app.requestedView = app.requestedView == View::slice ? View::max_intensity : View::slice;
+		if (input.IsKeyPressed(KEY_UP)) app.requestedSlice = std::min(app.descriptor.depth - 2, app.requestedSlice + 1);
+		if (input.IsKeyPressed(KEY_DOWN)) app.requestedSlice = std::max(1, app.requestedSlice - 1);
+		if (input.IsMouseButtonDown(MOUSE_BUTTON_LEFT))
+		{
+			auto mouse = fae::screen_to_world(reg, input.mousePosition);
+			float scale = app.descriptor.scale;
+			Vector3 cell = { mouse.x / scale, mouse.y / scale, (float)app.requestedSlice };
+			app.injections.push_back({ cell, 100.f, { input.mouseDelta.x, input.mouseDelta.y, 0 } });
+		}
+	}
+
+	// fixedUpdate, runs on the simulation thread
+	void simulate(fluid3d& app, entt::registry& reg)
+	{
+		View view;
+		int slice;
+		{
+			std::scoped_lock lock(app.injectionsMutex);
+			std::swap(app.injections, app.stepInjections);
+			view = app.requestedView;
+			slice = app.requestedSlice;
+		}
+		for (auto& injection : app.stepInjections)
+		{
+			app.f.addDensity(injection.cell, injection.density);
+			app.f.addVelocity(injection.cell, injection.velocity);
+		}
+		app.stepInjections.clear();
+
+		{
+			fae::profile_zone zone(reg, "Volume::step");
+			app.f.step();
+		}
+
+		auto& snapshot = app.snapshots.write_buffer();
+		app.f.render_view(view, slice, snapshot.image);
+		snapshot.view = view;
+		snapshot.slice = slice;
+		app.snapshots.publish();
+	}
+
+	void rasterize(fluid3d& app, entt::registry& reg)
+	{
+		app.snapshots.consume();
+		auto& snapshot = app.snapshots.read_buffer();
+		int N = app.descriptor.size;
+		if (snapshot.image.size() != size_t(N * N)) return;
+		auto cells = fae::visible_cells(reg, { 0, 0 }, app.descriptor.scale, N, N);
+		for (int j = cells.yBegin; j < cells.yEnd; j++)
+		{
+			for (int i = cells.xBegin; i < cells.xEnd; i++)
+			{
+				Color c = WHITE;
+				c.a = Clamp(snapshot.image[i + j * N], 0, 1) * 255;
+				app.pixels.At(i, j) = c;
+			}
+		}
+	}
+
+	void draw(fluid3d& app, entt::registry& reg)
+	{
+		int N = app.descriptor.size;
+		float scale = app.descriptor.scale;
+		fae::draw_pixel_grid(app.pixels, { 0, 0 }, scale, fae::visible_cells(reg, { 0, 0 }, scale, N, N));
+	}
+
+	// screen space, drawn in postRender after the camera plugin's end_camera2d
+	void draw_view(fluid3d& app, entt::registry& reg)
+	{
+		auto& snapshot = app.snapshots.read_buffer();
+		if (snapshot.view == View::slice) DrawText(TextFormat("view: slice z=%d (V, up/down)", snapshot.slice), 8, GetScreenHeight() - 18, 10, GREEN);
+		else DrawText(TextFormat("view: %s along z (V), injecting at z=%d", view_name(snapshot.view), snapshot.slice), 8, GetScreenHeight() - 18, 10, GREEN);
+	}
+
+	// emplaced after the camera plugin, so draw_view comes after end_camera2d as in fluid
+	static void overlay_plugin(const void*, entt::registry& reg)
+	{
+		auto& app = static_cast<fluid3d&>(reg.ctx().at<fae::application&>());
+		app.systems.postRender.emplace<&fluid3d::draw_view, const fluid3d, const Snapshot, fae::main_thread>(app);
+	}
+
+	void cleanup(fluid3d& app, entt::registry& reg)
+	{
+		fae::export_headless_snapshot(reg, app.pixels);
+		fae::unload_pixel_grid(app.pixels);
+	}
+
+	fluid3d()
+	{
+		registry.ctx().emplace<fae::WindowDescriptor>("3D Euler Fluid Simulation");
+		registry.ctx().emplace<fae::FixedTimestep>().threaded = true;
+		registry.ctx().emplace<fae::Camera2DController>();
+		scheduler.mode = fae::scheduler::execution_mode::parallel;
+		plugins.emplace(fae::rendering_plugin);
+		plugins.emplace(fae::time_plugin);
+		plugins.emplace(fae::input_plugin);
+		plugins.emplace(fae::camera2d_plugin);
+		plugins.emplace(fae::profiler_plugin);
+		plugins.emplace(overlay_plugin);
+		systems.start.emplace<&fluid3d::setup>(*this);
+		// as in fluid, the app is only read and Injection stands for everything behind injectionsMutex, so update and rasterize overlap
+		systems.update_controlled_gameobject.emplace<&fluid3d::update, const fluid3d, const fae::Input, const fae::ActiveCamera2D, Injection>(*this);
+		systems.fixedUpdate.emplace<&fluid3d::simulate>(*this);
+		systems.update_controlled_gameobject.emplace<&fluid3d::rasterize, const fluid3d, Snapshot, fae::PixelGrid, const fae::VisibleRegion>(*this);
+		systems.render.emplace<&fluid3d::draw, const fluid3d, const fae::PixelGrid, const fae::VisibleRegion, fae::main_thread>(*this);
+		systems.stop.emplace<&fluid3d::cleanup, fae::main_thread>(*this);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,412 @@
+#pragma once
+#include "../fae/fae.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Solvers for the pressure equation of fluid::Fluid::project, c * x[i] - a * (sum of the 4 neighbors of x[i]) = b[i],
+// over the interior of a width x height grid whose outer ring of cells is held fixed. Rows are split over a pool when given one,
+// and every reduction is summed per row then in row order, so results don't depend on the number of threads.
+
+enum class PressureSolver
+{
+	gauss_seidel,
+	multigrid,
+	conjugate_gradient,
+};
+
+const char* pressure_solver_name(PressureSolver solver)
+{
+	switch (solver)
+	{
+	case PressureSolver::multigrid: return "multigrid";
+	case PressureSolver::conjugate_gradient: return "conjugate gradient";
+	default: return "gauss-seidel";
+	}
+}
+
+struct SolveStats
+{
+	// sweeps, v-cycles or cg iterations depending on the solver
+	int iterations = 0;
+	// |b - Ax| / |b| when the solve ended
+	float residual = 0;
+};
+
+namespace pressure
+{
+	// interior rows [1, height - 1), in bands over the pool when there is one, flushing denormals on the workers
+	template<typename Fn>
+	void for_rows(fae::thread_pool* pool, int height, Fn&& fn)
+	{
+		if (!pool) return fn(1, height - 1);
+		int grain = std::max(4, height / int(4 * (pool->size() + 1)));
+		pool->parallel_for(1, height - 1, grain, [&](size_t rowBegin, size_t rowEnd)
+		{
+			fae::math::flush_denormals flush;
+			fn((int)rowBegin, (int)rowEnd);
+		});
+	}
+
+	// sum of rowSums in row order, deterministic however the rows were split
+	float sum_rows(const std::vector<double>& rowSums, int height)
+	{
+		double sum = 0;
+		for (int j = 1; j < height - 1; j++) sum += rowSums[j];
+		return (float)sum;
+	}
+
+	float apply(const float* x, int i, int width, float a, float c)
+	{
+		return c * x[i] - a * (x[i + 1] + x[i - 1] + x[i + width] + x[i - width]);
+	}
+
+	// r = b - Ax, returns |r|^2
+	float residual(const float* x, const float* b, float* r, int width, int height, float a, float c, std::vector<double>& rowSums, fae::thread_pool* pool)
+	{
+		rowSums.resize(height);
+		for_rows(pool, height, [&](int rowBegin, int rowEnd)
+		{
+			for (int j = rowBegin; j < rowEnd; j++)
+			{
+				double sum = 0;
+				for (int i = j * width + 1; i < (j + 1) * width - 1; i++)
+				{
+					r[i] = b[i] - apply(x, i, width, a, c);
+					sum += r[i] * r[i];
+				}
+				rowSums[j] = sum;
+			}
+		});
+		return sum_rows(rowSums, height);
+	}
+
+	float squared_norm(const float* x, int width, int height, std::vector<double>& rowSums, fae::thread_pool* pool)
+	{
+		rowSums.resize(height);
+		for_rows(pool, height, [&](int rowBegin, int rowEnd)
+		{
+			for (int j = rowBegin; j < rowEnd; j++)
+			{
+				double sum = 0;
+				for (int i = j * width + 1; i < (j + 1) * width - 1; i++) sum += x[i] * x[i];
+				rowSums[j] = sum;
+			}
+		});
+		return sum_rows(rowSums, height);
+	}
+}
+
+/// <summary>
+/// Geometric multigrid V-cycles with red-black Gauss-Seidel smoothing. Coarse cell I sits on fine cell 2I, residuals are restricted
+/// with full weighting and corrections prolongated bilinearly. Doubling the spacing quarters the neighbor coupling, so coarse levels
+/// solve with a' = a / 4 and c' = c - 3a, which keeps the c - 4a diagonal term unchanged. On even-sized levels the fixed boundary
+/// falls between the last coarse cell and the coarse outer ring, the diagonal of those cells makes up for it.
+/// Restriction is the transpose of prolongation over 4, so a V-cycle smoothing black then red on the way back up, with as many
+/// sweeps as on the way down, is a symmetric operator and can precondition conjugate gradient. Solving keeps red then black both ways,
+/// which converges in fewer cycles.
+/// </summary>
+struct MultigridSolver
+{
+	int preSmoothing = 2;
+	int postSmoothing = 2;
+	// half each way when preconditioning
+	int coarsestSweeps = 16;
+
+	SolveStats solve(float* x, const float* b, int width, int height, float a, float c, float tolerance, int maxCycles, fae::thread_pool* pool)
+	{
+		prepare(x, b, width, height, a, c);
+		auto& fine = levels[0];
+
+		SolveStats stats;
+		float bNorm = std::sqrt(pressure::squared_norm(b, width, height, rowSums, pool));
+		if (bNorm == 0) return stats;
+		stats.residual = std::sqrt(pressure::residual(x, b, fine.r.data(), width, height, a, c, rowSums, pool)) / bNorm;
+		while (stats.residual > tolerance && stats.iterations < maxCycles)
+		{
+			v_cycle(0, pool);
+			stats.iterations++;
+			stats.residual = std::sqrt(pressure::residual(x, b, fine.r.data(), width, height, a, c, rowSums, pool)) / bNorm;
+		}
+		return stats;
+	}
+
+	// z = one symmetric V-cycle from zero on Az = r, an approximation of the inverse of A applied to r
+	void precondition(float* z, const float* r, int width, int height, float a, float c, fae::thread_pool* pool)
+	{
+		std::fill_n(z, (size_t)width * height, 0.f);
+		prepare(z, r, width, height, a, c);
+		v_cycle(0, pool, true);
+	}
+
+private:
+	struct level
+	{
+		int width = 0;
+		int height = 0;
+		float a = 0;
+		float c = 0;
+		// distance from the last interior column and row to the fixed boundary, in this level's cells
+		float farX = 1;
+		float farY = 1;
+		std::vector<float> diagonal;
+		// the finest level points at the caller's buffers, coarser ones at their own storage
+		float* x = nullptr;
+		const float* b = nullptr;
+		std::vector<float> r;
+		std::vector<float> ownX;
+		std::vector<float> ownB;
+	};
+
+	// levels past depth are left from larger grids, so a grid changing size every solve reuses their storage
+	std::vector<level> levels;
+	size_t depth = 0;
+	std::vector<double> rowSums;
+
+	void prepare(float* x, const float* b, int width, int height, float a, float c)
+	{
+		bool rebuilt = build_levels(width, height);
+		auto& fine = levels[0];
+		fine.x = x;
+		fine.b = b;
+		if (!rebuilt && fine.a == a && fine.c == c) return;
+		fine.a = a;
+		fine.c = c;
+		for (size_t l = 1; l < depth; l++)
+		{
+			levels[l].a = levels[l - 1].a / 4;
+			levels[l].c = levels[l - 1].c - 3 * levels[l - 1].a;
+		}
+		for (size_t l = 0; l < depth; l++) build_diagonal(levels[l]);
+	}
+
+	// whether the levels changed
+	bool build_levels(int width, int height)
+	{
+		if (depth > 0 && levels[0].width == width && levels[0].height == height) return false;
+		depth = 0;
+		int interiorWidth = width - 2;
+		int interiorHeight = height - 2;
+		float farX = 1;
+		float farY = 1;
+		while (true)
+		{
+			if (depth == levels.size()) levels.emplace_back();
+			auto& current = levels[depth++];
+			current.width = interiorWidth + 2;
+			current.height = interiorHeight + 2;
+			current.farX = farX;
+			current.farY = farY;
+			current.r.assign((size_t)current.width * current.height, 0.f);
+			current.diagonal.assign(current.r.size(), 0.f);
+			if (depth > 1)
+			{
+				current.ownX.assign(current.r.size(), 0.f);
+				current.ownB.assign(current.r.size(), 0.f);
+				current.x = current.ownX.data();
+				current.b = current.ownB.data();
+			}
+			if (interiorWidth <= 4 || interiorHeight <= 4) break;
+			coarsen(interiorWidth, farX);
+			coarsen(interiorHeight, farY);
+		}
+		return true;
+	}
+
+	// coarse cells are the even fine cells strictly inside the boundary
+	static void coarsen(int& interior, float& far)
+	{
+		float boundary = interior + far;
+		int coarseInterior = (int)std::ceil(boundary / 2) - 1;
+		far = (boundary - 2 * coarseInterior) / 2;
+		interior = coarseInterior;
+	}
+
+	// the ghost value past the last cell extrapolates linearly to zero at the boundary, which folds into the diagonal
+	void build_diagonal(level& current)
+	{
+		std::fill(current.diagonal.begin(), current.diagonal.end(), current.c);
+		float extraX = current.a * (1 / current.farX - 1);
+		float extraY = current.a * (1 / current.farY - 1);
+		for (int j = 1; j < current.height - 1; j++) current.diagonal[current.width - 2 + j * current.width] += extraX;
+		for (int i = 1; i < current.width - 1; i++) current.diagonal[i + (current.height - 2) * current.width] += extraY;
+	}
+
+	// black then red when reversed, undoing the order of the sweeps before it
+	void smooth(level& current, int sweeps, fae::thread_pool* pool, bool reversed = false)
+	{
+		for (int sweep = 0; sweep < sweeps; sweep++)
+		{
+			red_black_sweep(current, reversed ? 1 : 0, pool);
+			red_black_sweep(current, reversed ? 0 : 1, pool);
+		}
+	}
+
+	void red_black_sweep(level& current, int color, fae::thread_pool* pool)
+	{
+		int width = current.width;
+		float a = current.a;
+		pressure::for_rows(pool, current.height, [&](int rowBegin, int rowEnd)
+		{
+			for (int j = rowBegin; j < rowEnd; j++)
+			{
+				float* x = current.x + j * width;
+				const float* b = current.b + j * width;
+				const float* diagonal = current.diagonal.data() + j * width;
+				for (int i = ((j + color) & 1) ? 1 : 2; i < width - 1; i += 2)
+				{
+					x[i] = (b[i] + a * (x[i + 1] + x[i - 1] + x[i + width] + x[i - width])) / diagonal[i];
+				}
+			}
+		});
+	}
+
+	void residual(level& current, fae::thread_pool* pool)
+	{
+		int width = current.width;
+		float a = current.a;
+		pressure::for_rows(pool, current.height, [&](int rowBegin, int rowEnd)
+		{
+			const float* x = current.x;
+			for (int j = rowBegin; j < rowEnd; j++)
+			{
+				for (int i = j * width + 1; i < (j + 1) * width - 1; i++)
+				{
+					current.r[i] = current.b[i] - (current.diagonal[i] * x[i] - a * (x[i + 1] + x[i - 1] + x[i + width] + x[i - width]));
+				}
+			}
+		});
+	}
+
+	void v_cycle(size_t l, fae::thread_pool* pool, bool symmetric = false)
+	{
+		auto& current = levels[l];
+		if (l + 1 == depth)
+		{
+			if (!symmetric) return smooth(current, coarsestSweeps, pool);
+			smooth(current, coarsestSweeps / 2, pool);
+			smooth(current, coarsestSweeps / 2, pool, true);
+			return;
+		}
+
+		smooth(current, preSmoothing, pool);
+		residual(current, pool);
+
+		auto& coarse = levels[l + 1];
+		restrict_residual(current, coarse, pool);
+		std::fill(coarse.ownX.begin(), coarse.ownX.end(), 0.f);
+		v_cycle(l + 1, pool, symmetric);
+		prolongate_correction(coarse, current, pool);
+
+		smooth(current, postSmoothing, pool, symmetric);
+	}
+
+	// coarse b = fine residuals around 2I, 2J weighted 1/4 at the center, 1/8 on the sides and 1/16 on the corners
+	void restrict_residual(const level& fine, level& coarse, fae::thread_pool* pool)
+	{
+		pressure::for_rows(pool, coarse.height, [&](int rowBegin, int rowEnd)
+		{
+			for (int J = rowBegin; J < rowEnd; J++)
+			{
+				for (int I = 1; I < coarse.width - 1; I++)
+				{
+					// fine cells past an even interior are the zero outer ring, r is never written there
+					const float* r = fine.r.data() + 2 * I + 2 * J * fine.width;
+					int w = fine.width;
+					coarse.ownB[I + J * coarse.width] = 0.25f * r[0]
+						+ 0.125f * (r[1] + r[-1] + r[w] + r[-w])
+						+ 0.0625f * (r[w + 1] + r[w - 1] + r[-w + 1] + r[-w - 1]);
+				}
+			}
+		});
+	}
+
+	// adds the coarse correction to the fine x, fine cells between coarse ones take the average of their 2 or 4 neighbors
+	void prolongate_correction(const level& coarse, level& fine, fae::thread_pool* pool)
+	{
+		pressure::for_rows(pool, fine.height, [&](int rowBegin, int rowEnd)
+		{
+			for (int j = rowBegin; j < rowEnd; j++)
+			{
+				// the coarse outer ring is zero, matching the fixed fine boundary
+				const float* below = coarse.x + (j / 2) * coarse.width;
+				const float* above = coarse.x + ((j + 1) / 2) * coarse.width;
+				float* row = fine.x + j * fine.width;
+				for (int i = 1; i < fine.width - 1; i++)
+				{
+					int left = i / 2;
+					int right = (i + 1) / 2;
+					row[i] += 0.25f * (below[left] + below[right] + above[left] + above[right]);
+				}
+			}
+		});
+	}
+};
+
+/// <summary>
+/// Conjugate gradient preconditioned with one MultigridSolver V-cycle per iteration, which takes care of the smooth error
+/// plain conjugate gradient needs many iterations for. The V-cycle being symmetric keeps the iteration conjugate.
+/// </summary>
+struct ConjugateGradientSolver
+{
+	MultigridSolver preconditioner;
+
+	SolveStats solve(float* x, const float* b, int width, int height, float a, float c, float tolerance, int maxIterations, fae::thread_pool* pool)
+	{
+		size_t size = (size_t)width * height;
+		// the direction needs a zero outer ring for the operator, the others are only read inside
+		r.assign(size, 0.f);
+		z.assign(size, 0.f);
+		d.assign(size, 0.f);
+		q.assign(size, 0.f);
+
+		SolveStats stats;
+		float bNorm = std::sqrt(pressure::squared_norm(b, width, height, rowSums, pool));
+		if (bNorm == 0) return stats;
+		float rNorm = std::sqrt(pressure::residual(x, b, r.data(), width, height, a, c, rowSums, pool));
+		stats.residual = rNorm / bNorm;
+
+		preconditioner.precondition(z.data(), r.data(), width, height, a, c, pool);
+		float rz = for_interior(width, height, pool, [&](int i) { d[i] = z[i]; return r[i] * z[i]; });
+		while (stats.residual > tolerance && stats.iterations < maxIterations)
+		{
+			float dq = for_interior(width, height, pool, [&](int i) { q[i] = pressure::apply(d.data(), i, width, a, c); return d[i] * q[i]; });
+			float alpha = rz / dq;
+			float rr = for_interior(width, height, pool, [&](int i) { x[i] += alpha * d[i]; r[i] -= alpha * q[i]; return r[i] * r[i]; });
+			stats.iterations++;
+			stats.residual = std::sqrt(rr) / bNorm;
+			if (stats.residual <= tolerance) break;
+
+			preconditioner.precondition(z.data(), r.data(), width, height, a, c, pool);
+			float rzNext = for_interior(width, height, pool, [&](int i) { return r[i] * z[i]; });
+			float beta = rzNext / rz;
+			rz = rzNext;
+			for_interior(width, height, pool, [&](int i) { d[i] = z[i] + beta * d[i]; return 0.f; });
+		}
+		return stats;
+	}
+
+private:
+	std::vector<float> r;
+	std::vector<float> z;
+	std::vector<float> d;
+	std::vector<float> q;
+	std::vector<double> rowSums;
+
+	// calls fn on every interior cell and returns the sum of what it returned
+	template<typename Fn>
+	float for_interior(int width, int height, fae::thread_pool* pool, Fn&& fn)
+	{
+		rowSums.resize(height);
+		pressure::for_rows(pool, height, [&](int rowBegin, int rowEnd)
+		{
+			for (int j = rowBegin; j < rowEnd; j++)
+			{
+				double sum = 0;
+				for (int i = j * width + 1; i < (j + 1) * width - 1; i++) sum += fn(i);
+				rowSums[j] = sum;
+			}
+		});
+		return pressure::sum_rows(rowSums, height);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,445 @@
+#pragma once
+#include "../fae/fae.h"
+#include "../fae/mapped_file.h"
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+
+// how the frames of a recording are stored
+enum class RecordingEncoding : uint32_t
+{
+	// float32 as simulated, every frame stands alone
+	raw,
+	// 16 bits a value scaled to the largest magnitude of its field, runs of zeros collapsed, every frame stands alone
+	quantized,
+	// quantized differences from the frame before at the last keyframe's precision, with a quantized keyframe every keyframeInterval frames
+	delta,
+};
+
+const char* recording_encoding_name(RecordingEncoding encoding)
+{
+	switch (encoding)
+	{
+	case RecordingEncoding::raw: return "raw";
+	case RecordingEncoding::quantized: return "quantized";
+	default: return "delta";
+	}
+}
+
+/// <summary>
+/// Recording file layout, native endianness:
+/// FileHeader, then a chunk per frame (ChunkHeader and payloadBytes of payload, padded to 4 bytes), then the index,
+/// an IndexEntry per frame, and the Footer last so a reader can find the index from the end of the file.
+/// A frame is the density, x velocity and y velocity planes of an N x N grid. Raw payloads are the planes as floats,
+/// the others a stream of 16-bit tokens for all three: 0 and a count is a run of zeros, anything else a value biased by 32768
+/// and multiplied by the plane's scale, on its own for keyframes or added to the frame before for deltas.
+/// </summary>
+namespace recording
+{
+	constexpr int fields = 3;
+
+	struct FileHeader
+	{
+		char magic[4] = { 'F', 'L', 'R', 'C' };
+		uint32_t version = 1;
+		uint32_t size = 0;
+		uint32_t fields = recording::fields;
+	};
+
+	struct ChunkHeader
+	{
+		uint32_t frame = 0;
+		RecordingEncoding encoding = RecordingEncoding::raw;
+		// decodes without the frame before
+		uint32_t keyframe = 1;
+		uint32_t payloadBytes = 0;
+		float scales[fields] = {};
+	};
+
+	struct IndexEntry
+	{
+		uint64_t offset = 0;
+		uint32_t frame = 0;
+		uint32_t keyframe = 1;
+	};
+
+	struct Footer
+	{
+		uint64_t indexOffset = 0;
+		uint32_t frameCount = 0;
+		char magic[4] = { 'F', 'L', 'I', 'X' };
+	};
+
+	// the largest grid a replay opens, the fluid's own --size limit, so a corrupt header can't ask for gigabytes of state
+	constexpr uint32_t maxSize = 8192;
+
+	constexpr int maxQuantized = 32767;
+	constexpr uint32_t tokenBias = 32768;
+	constexpr uint16_t maxRun = 65535;
+
+	// quantizes values, or their difference from reconstructed for deltas, into tokens and leaves reconstructed
+	// holding exactly what decode_plane will produce from them. Steps are never finer than minScale, so deltas
+	// on a keyframe's scale turn changes too small to show at its precision into runs of zeros
+	float encode_plane(const float* values, float* reconstructed, size_t count, bool delta, std::vector<uint16_t>& tokens, float minScale = 0)
+	{
+		float largest = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			largest = std::max(largest, std::abs(values[i] - (delta ? reconstructed[i] : 0.f)));
+		}
+		float scale = std::max(minScale, largest > 0 ? largest / maxQuantized : 1.f);
+		float inverse = 1 / scale;
+
+		uint16_t zeros = 0;
+		auto flush = [&]
+		{
+			if (!zeros) return;
+			tokens.push_back(0);
+			tokens.push_back(zeros);
+			zeros = 0;
+		};
+		for (size_t i = 0; i < count; i++)
+		{
+			float base = delta ? reconstructed[i] : 0.f;
+			int q = std::clamp((int)std::lround((values[i] - base) * inverse), -maxQuantized, maxQuantized);
+			reconstructed[i] = base + float(q) * scale;
+			if (q == 0)
+			{
+				if (++zeros == maxRun) flush();
+				continue;
+			}
+			flush();
+			tokens.push_back(uint16_t(q + (int)tokenBias));
+		}
+		flush();
+		return scale;
+	}
+
+	// false when the tokens don't add up to count values
+	bool decode_plane(const uint16_t*& token, const uint16_t* end, float* out, size_t count, bool delta, float scale)
+	{
+		size_t i = 0;
+		while (i < count)
+		{
+			if (token == end) return false;
+			uint16_t value = *token++;
+			if (value != 0)
+			{
+				out[i] = (delta ? out[i] : 0.f) + float(int(value) - (int)tokenBias) * scale;
+				i++;
+				continue;
+			}
+			if (token == end) return false;
+			size_t run = *token++;
+			if (i + run > count) return false;
+			// adding zero leaves a delta's values as they are
+			if (!delta) std::fill_n(out + i, run, 0.f);
+			i += run;
+		}
+		return true;
+	}
+}
+
+/// <summary>
+/// Streams density and velocity frames to a recording file. record copies the frame and hands it to a writer thread,
+/// which encodes and writes it, so the simulation only waits when maxQueuedFrames are still waiting to be written.
+/// close (or the destructor) writes out what's queued and the index.
+/// </summary>
+struct FluidRecorder
+{
+	RecordingEncoding encoding = RecordingEncoding::delta;
+	// frames between keyframes with delta encoding, a seek decodes at most this many
+	int keyframeInterval = 30;
+	size_t maxQueuedFrames = 8;
+
+	FluidRecorder() = default;
+	FluidRecorder(const FluidRecorder&) = delete;
+	FluidRecorder& operator=(const FluidRecorder&) = delete;
+	~FluidRecorder() { close(); }
+
+	bool open(const std::string& path, int size)
+	{
+		close();
+		file = std::fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			TraceLog(LOG_WARNING, "RECORDING: could not open %s", path.c_str());
+			return false;
+		}
+		this->path = path;
+		N = size;
+		recording::FileHeader header;
+		header.size = N;
+		failed = std::fwrite(&header, sizeof(header), 1, file) != 1;
+		offset = sizeof(header);
+		framesQueued = 0;
+		index.clear();
+		reconstructed.assign(plane() * recording::fields, 0.f);
+		stopping = false;
+		writer = std::thread([this] { write_frames(); });
+		return true;
+	}
+
+	bool is_open() const { return file != nullptr; }
+
+	// simulation thread, each span N * N
+	void record(std::span<const float> density, std::span<const float> velocX, std::span<const float> velocY)
+	{
+		if (!file) return;
+		Frame frame;
+		{
+			std::unique_lock lock(mutex);
+			changed.wait(lock, [&] { return queue.size() < maxQueuedFrames; });
+			if (!spare.empty())
+			{
+				frame.planes = std::move(spare.back());
+				spare.pop_back();
+			}
+		}
+		frame.number = framesQueued++;
+		frame.planes.resize(plane() * recording::fields);
+		std::copy_n(density.begin(), plane(), frame.planes.begin());
+		std::copy_n(velocX.begin(), plane(), frame.planes.begin() + plane());
+		std::copy_n(velocY.begin(), plane(), frame.planes.begin() + 2 * plane());
+		{
+			std::scoped_lock lock(mutex);
+			queue.push_back(std::move(frame));
+		}
+		changed.notify_all();
+	}
+
+	void close()
+	{
+		if (!file) return;
+		{
+			std::scoped_lock lock(mutex);
+			stopping = true;
+		}
+		changed.notify_all();
+		writer.join();
+
+		recording::Footer footer;
+		footer.indexOffset = offset;
+		footer.frameCount = (uint32_t)index.size();
+		if (!index.empty()) failed |= std::fwrite(index.data(), sizeof(index[0]), index.size(), file) != index.size();
+		failed |= std::fwrite(&footer, sizeof(footer), 1, file) != 1;
+		failed |= std::fclose(file) != 0;
+		file = nullptr;
+		if (failed) TraceLog(LOG_WARNING, "RECORDING: could not write all of %s", path.c_str());
+		else TraceLog(LOG_INFO, "RECORDING: wrote %zu frames (%.2f MB) to %s", index.size(), offset / 1e6, path.c_str());
+	}
+
+	// bytes of chunks written so far, index and footer excluded. Only stable once closed
+	uint64_t bytes_written() const { return offset; }
+
+private:
+	struct Frame
+	{
+		std::vector<float> planes;
+		uint32_t number = 0;
+	};
+
+	std::string path;
+	std::FILE* file = nullptr;
+	int N = 0;
+	uint32_t framesQueued = 0;
+
+	std::thread writer;
+	std::mutex mutex;
+	// signals queued frames to the writer and free slots to record
+	std::condition_variable changed;
+	std::deque<Frame> queue;
+	// buffers of written frames for record to reuse
+	std::vector<std::vector<float>> spare;
+	bool stopping = false;
+
+	// writer thread only until close joins it
+	std::vector<float> reconstructed;
+	std::vector<uint16_t> tokens;
+	float keyframeScales[recording::fields] = {};
+	std::vector<recording::IndexEntry> index;
+	uint64_t offset = 0;
+	bool failed = false;
+
+	size_t plane() const { return (size_t)N * N; }
+
+	void write_frames()
+	{
+		while (true)
+		{
+			Frame frame;
+			{
+				std::unique_lock lock(mutex);
+				changed.wait(lock, [&] { return stopping || !queue.empty(); });
+				if (queue.empty()) return;
+				frame = std::move(queue.front());
+				queue.pop_front();
+			}
+			write_frame(frame);
+			{
+				std::scoped_lock lock(mutex);
+				spare.push_back(std::move(frame.planes));
+			}
+			changed.notify_all();
+		}
+	}
+
+	void write_frame(const Frame& frame)
+	{
+		recording::ChunkHeader chunk;
+		chunk.frame = frame.number;
+		chunk.encoding = encoding;
+		chunk.keyframe = encoding != RecordingEncoding::delta || frame.number % std::max(1, keyframeInterval) == 0;
+
+		const void* payload = frame.planes.data();
+		if (encoding == RecordingEncoding::raw)
+		{
+			chunk.payloadBytes = uint32_t(frame.planes.size() * sizeof(float));
+		}
+		else
+		{
+			tokens.clear();
+			for (int f = 0; f < recording::fields; f++)
+			{
+				chunk.scales[f] = recording::encode_plane(frame.planes.data() + f * plane(), reconstructed.data() + f * plane(), plane(), !chunk.keyframe, tokens,
+					chunk.keyframe ? 0.f : keyframeScales[f]);
+				if (chunk.keyframe) keyframeScales[f] = chunk.scales[f];
+			}
+			chunk.payloadBytes = uint32_t(tokens.size() * sizeof(uint16_t));
+			payload = tokens.data();
+		}
+
+		// chunks stay 4-byte aligned, raw payloads are floats
+		static constexpr char padding[4] = {};
+		size_t paddingBytes = (4 - chunk.payloadBytes % 4) % 4;
+		index.push_back({ offset, chunk.frame, chunk.keyframe });
+		failed |= std::fwrite(&chunk, sizeof(chunk), 1, file) != 1;
+		if (chunk.payloadBytes) failed |= std::fwrite(payload, chunk.payloadBytes, 1, file) != 1;
+		if (paddingBytes) failed |= std::fwrite(padding, paddingBytes, 1, file) != 1;
+		offset += sizeof(chunk) + chunk.payloadBytes + paddingBytes;
+	}
+};
+
+/// <summary>
+/// Plays a recording back from a memory map. Reading a frame decodes from the closest keyframe at or before it,
+/// or just the next chunk when it follows the frame read last, so scrubbing never decodes the whole run.
+/// </summary>
+struct FluidReplay
+{
+	// false when the file is missing, truncated or not a recording
+	bool open(const std::string& path)
+	{
+		index.clear();
+		stateFrame = -1;
+		if (!file.open(path)) return false;
+
+		recording::FileHeader expected;
+		recording::Footer footer;
+		if (file.size() < sizeof(header) + sizeof(footer)) return close();
+		std::memcpy(&header, file.data(), sizeof(header));
+		std::memcpy(&footer, file.data() + file.size() - sizeof(footer), sizeof(footer));
+		if (std::memcmp(header.magic, expected.magic, 4) != 0 || header.version != expected.version || header.fields != recording::fields) return close();
+		if (std::memcmp(footer.magic, recording::Footer().magic, 4) != 0 || header.size < 3 || header.size > recording::maxSize) return close();
+		uint64_t indexBytes = uint64_t(footer.frameCount) * sizeof(recording::IndexEntry);
+		if (footer.indexOffset < sizeof(header) || footer.indexOffset + indexBytes + sizeof(footer) != file.size()) return close();
+
+		index.resize(footer.frameCount);
+		if (!index.empty()) std::memcpy(index.data(), file.data() + footer.indexOffset, indexBytes);
+		for (uint32_t i = 0; i < footer.frameCount; i++)
+		{
+			// frames are numbered from 0 in order and every chunk header has to lie before the index
+			if (index[i].frame != i || index[i].offset + sizeof(recording::ChunkHeader) > footer.indexOffset) return close();
+			if (i == 0 && !index[i].keyframe) return close();
+		}
+		chunksEnd = footer.indexOffset;
+		state.assign(plane() * recording::fields, 0.f);
+		return true;
+	}
+
+	bool is_open() const { return file.is_open(); }
+	int size() const { return (int)header.size; }
+	uint32_t frame_count() const { return (uint32_t)index.size(); }
+
+	// each of density, velocX and velocY is resized to N * N. False past the end or on a corrupt chunk
+	bool read(uint32_t frame, std::vector<float>& density, std::vector<float>& velocX, std::vector<float>& velocY)
+	{
+		decoded = 0;
+		if (frame >= index.size()) return false;
+		uint32_t first = frame;
+		while (!index[first].keyframe) first--;
+		// carry on from the state when it's between that keyframe and the frame
+		if (stateFrame >= (int64_t)first && stateFrame <= (int64_t)frame) first = uint32_t(stateFrame + 1);
+		for (uint32_t f = first; f <= frame; f++)
+		{
+			if (!decode(f))
+			{
+				stateFrame = -1;
+				return false;
+			}
+			stateFrame = f;
+		}
+
+		for (auto* out : { &density, &velocX, &velocY }) out->resize(plane());
+		std::copy_n(state.begin(), plane(), density.begin());
+		std::copy_n(state.begin() + plane(), plane(), velocX.begin());
+		std::copy_n(state.begin() + 2 * plane(), plane(), velocY.begin());
+		return true;
+	}
+
+	// frames decoded by the last read, 0 when it had the frame already
+	uint32_t last_decoded() const { return decoded; }
+
+private:
+	fae::mapped_file file;
+	recording::FileHeader header;
+	std::vector<recording::IndexEntry> index;
+	uint64_t chunksEnd = 0;
+	// the three planes of frame stateFrame, -1 when nothing was decoded yet
+	std::vector<float> state;
+	int64_t stateFrame = -1;
+	std::vector<uint16_t> tokens;
+	uint32_t decoded = 0;
+
+	size_t plane() const { return (size_t)header.size * header.size; }
+
+	bool close()
+	{
+		file.close();
+		index.clear();
+		return false;
+	}
+
+	bool decode(uint32_t frame)
+	{
+		recording::ChunkHeader chunk;
+		uint64_t offset = index[frame].offset;
+		std::memcpy(&chunk, file.data() + offset, sizeof(chunk));
+		const std::byte* payload = file.data() + offset + sizeof(chunk);
+		if (chunk.frame != frame || offset + sizeof(chunk) + chunk.payloadBytes > chunksEnd) return false;
+		decoded++;
+
+		if (chunk.encoding == RecordingEncoding::raw)
+		{
+			if (chunk.payloadBytes != state.size() * sizeof(float)) return false;
+			std::memcpy(state.data(), payload, chunk.payloadBytes);
+			return true;
+		}
+		if (chunk.encoding != RecordingEncoding::quantized && chunk.encoding != RecordingEncoding::delta) return false;
+
+		// copied out so the tokens are aligned whatever the mapping is
+		tokens.resize(chunk.payloadBytes / sizeof(uint16_t));
+		std::memcpy(tokens.data(), payload, tokens.size() * sizeof(uint16_t));
+		const uint16_t* token = tokens.data();
+		const uint16_t* end = token + tokens.size();
+		for (int f = 0; f < recording::fields; f++)
+		{
+			if (!recording::decode_plane(token, end, state.data() + f * plane(), plane(), !chunk.keyframe, chunk.scales[f])) return false;
+		}
+		return token == end;
+	}
+};
\ No newline at end of file
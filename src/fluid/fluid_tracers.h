@@ -0,0 +1,134 @@
+#pragma once
+#include "../fae/fae.h"
+#include <atomic>
+#include <random>
+
+/// <summary>
+/// Massless particles carried along by a fluid's velocity, as x and y arrays in cell units so a chunk of them
+/// is sampled from both velocity fields in one SIMD bilinear pass. advect and splat split the particles over the pool.
+/// </summary>
+struct FluidTracers
+{
+	// particles sampled and moved together, small enough for their velocities to stay on the stack
+	static constexpr size_t chunkSize = 1024;
+
+	std::vector<float> x;
+	std::vector<float> y;
+	// advect steps between reordering the particles by cell, so neighbours in the arrays sample neighbouring velocities
+	// from cache instead of all over the grid. Particles drift slowly, their order goes stale over many steps. 0 never sorts
+	int sortInterval = 16;
+	// alpha each particle adds to its pixel when splatted
+	int intensity = 48;
+	Color color = SKYBLUE;
+
+	size_t count() const { return x.size(); }
+
+	// spread uniformly over the inside of an N x N grid, the same seed gives the same particles
+	void seed(size_t count, int N, uint32_t seed = 1)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> position(1.f, N - 1.f);
+		stepsSinceSort = 0;
+		x.resize(count);
+		y.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			x[i] = position(random);
+			y[i] = position(random);
+		}
+	}
+
+	// moves every particle by the velocity at its position over dt, scaled the way the fluid's own advection is.
+	// Velocities are sampled where the particle starts the step, particles stay inside the grid's walls
+	template<typename T>
+	void advect(const T* velocX, const T* velocY, int N, float dt, fae::thread_pool* pool = nullptr)
+	{
+		if (sortInterval > 0 && stepsSinceSort++ % sortInterval == 0) sort_by_cell(N);
+		size_t chunks = (count() + chunkSize - 1) / chunkSize;
+		auto run = [&](size_t begin, size_t end) { for (size_t c = begin; c < end; c++) advect_chunk(c, velocX, velocY, N, dt); };
+		if (pool) pool->parallel_for(0, chunks, 16, run);
+		else run(0, chunks);
+	}
+
+	// draws the particles into pixels, a grid of resolution pixels per cell, as color with alpha from how many share a pixel
+	void splat(std::vector<Color>& pixels, int width, int height, float resolution, fae::thread_pool* pool = nullptr)
+	{
+		size_t size = (size_t)width * height;
+		hits.assign(size, 0);
+		size_t chunks = (count() + chunkSize - 1) / chunkSize;
+		auto count_hits = [&](size_t begin, size_t end)
+		{
+			for (size_t c = begin; c < end; c++)
+			{
+				size_t last = std::min(count(), (c + 1) * chunkSize);
+				for (size_t i = c * chunkSize; i < last; i++)
+				{
+					// cell i is sampled at i and drawn over [i, i + 1) times resolution, so positions sit half a cell in
+					int px = std::clamp((int)((x[i] + 0.5f) * resolution), 0, width - 1);
+					int py = std::clamp((int)((y[i] + 0.5f) * resolution), 0, height - 1);
+					std::atomic_ref<uint32_t>(hits[px + (size_t)py * width]).fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		};
+		if (pool) pool->parallel_for(0, chunks, 16, count_hits);
+		else count_hits(0, chunks);
+
+		pixels.resize(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			Color c = color;
+			c.a = (unsigned char)std::min<uint32_t>(255, hits[i] * intensity);
+			pixels[i] = c;
+		}
+	}
+
+private:
+	// how many particles landed on each pixel, atomics only while splatting
+	std::vector<uint32_t> hits;
+	int stepsSinceSort = 0;
+	// counting sort scratch
+	std::vector<uint32_t> cellStarts;
+	std::vector<float> sortedX, sortedY;
+
+	// counting sort on the row-major cell of each particle, stable so particles sharing a cell keep their order
+	void sort_by_cell(int N)
+	{
+		auto cell = [&](size_t i) { return (size_t)std::clamp((int)y[i], 0, N - 1) * N + std::clamp((int)x[i], 0, N - 1); };
+		cellStarts.assign((size_t)N * N + 1, 0);
+		for (size_t i = 0; i < count(); i++) cellStarts[cell(i) + 1]++;
+		for (size_t c = 1; c < cellStarts.size(); c++) cellStarts[c] += cellStarts[c - 1];
+		sortedX.resize(count());
+		sortedY.resize(count());
+		for (size_t i = 0; i < count(); i++)
+		{
+			uint32_t to = cellStarts[cell(i)]++;
+			sortedX[to] = x[i];
+			sortedY[to] = y[i];
+		}
+		x.swap(sortedX);
+		y.swap(sortedY);
+	}
+
+	template<typename T>
+	void advect_chunk(size_t chunk, const T* velocX, const T* velocY, int N, float dt)
+	{
+		size_t begin = chunk * chunkSize;
+		size_t n = std::min(count(), begin + chunkSize) - begin;
+		float u[chunkSize];
+		float v[chunkSize];
+		const T* fields[] = { velocX, velocY };
+		float* outs[] = { u, v };
+		fae::math::bilinear_sample(std::span<const T* const>(fields), N, N, { x.data() + begin, n }, { y.data() + begin, n }, outs);
+
+		float dtx = dt * (N - 2);
+		float low = 0.5f;
+		float high = N - 1.5f;
+		float* px = x.data() + begin;
+		float* py = y.data() + begin;
+		for (size_t i = 0; i < n; i++)
+		{
+			px[i] = std::clamp(px[i] + dtx * u[i], low, high);
+			py[i] = std::clamp(py[i] + dtx * v[i], low, high);
+		}
+	}
+};
\ No newline at end of file
@@ -1,7 +1,8 @@
 #pragma once
 #include "../fae/fae.h"
-#include <string>
 #include <format>
+#include <iterator>
+#include <string>
 
 struct lerp_visualizer : public fae::application
 {
@@ -28,8 +29,23 @@ struct lerp_visualizer : public fae::application
 
 	Slider* slider;
 
+	// headless default: keep dragging the slider handle back and forth
+	static void headless_script(size_t frame, fae::Input& input)
+	{
+		fae::WindowDescriptor window;
+		float direction = (frame / 120) % 2 == 0 ? 1.f : -1.f;
+		if (frame == 1) input.mousePosition = { window.width * 0.1f, window.height - window.height * 0.25f };
+		input.mousePosition.x += direction * 4.f;
+		input.mouseDown[MOUSE_BUTTON_LEFT] = true;
+	}
+
 	void setup(lerp_visualizer& app, entt::registry& reg)
 	{
+		if (auto headless = reg.ctx().find<fae::HeadlessDescriptor>(); headless && !headless->script)
+		{
+			headless->script = headless_script;
+		}
+
 		auto pointAEntity = reg.create();
 		auto& pointA = reg.emplace<Point>(pointAEntity, 256.f, 312.f);
 
@@ -48,21 +64,25 @@ struct lerp_visualizer : public fae::application
 
 	void draw_points(lerp_visualizer& app, entt::registry& reg)
 	{
+		auto& arena = reg.ctx().at<fae::FrameArena>();
 		for (auto&& [entity, point] : reg.view<const Point>().each())
 		{
 			DrawCircle(point.position.x, point.position.y, 10, point.color);
-			auto text = std::format("({:.2f},{:.2f})", point.position.x, point.position.y);
+			std::pmr::string text(&arena);
+			std::format_to(std::back_inserter(text), "({:.2f},{:.2f})", point.position.x, point.position.y);
 			DrawText(text.c_str(), point.position.x - MeasureText(text.c_str(), 32) * .5f, point.position.y + 8, 32, point.color);
 		}
 	}
 
 	void draw_sliders(lerp_visualizer& app, entt::registry& reg)
 	{
+		auto& input = reg.ctx().at<fae::Input>();
+		auto& arena = reg.ctx().at<fae::FrameArena>();
 		for (auto&& [entity, slider] : reg.view<const Slider>().each())
 		{
 			DrawLine(slider.position.x - slider.width * .5f, slider.position.y, slider.position.x + slider.width * .5f, slider.position.y, BLACK);
 			Color rectangleColor = GRAY;
-			if (CheckCollisionPointRec(GetMousePosition(), slider.rectangle))
+			if (CheckCollisionPointRec(input.mousePosition, slider.rectangle))
 			{
 				rectangleColor = RAYWHITE;
 				SetMouseCursor(MOUSE_CURSOR_POINTING_HAND);
@@ -74,27 +94,30 @@ struct lerp_visualizer : public fae::application
 			DrawText("1", slider.position.x + slider.width * .5f + 8, slider.position.y + slider.rectangle.height * .5f, 32, BLACK);
 			if (slider.value > 0.04f && slider.value < 0.96f)
 			{
-				DrawText(std::format("{:.2f}", slider.value).c_str(), slider.rectangle.x, slider.position.y + slider.rectangle.height * .5f, 32, BLACK);
+				std::pmr::string text(&arena);
+				std::format_to(std::back_inserter(text), "{:.2f}", slider.value);
+				DrawText(text.c_str(), slider.rectangle.x, slider.position.y + slider.rectangle.height * .5f, 32, BLACK);
 			}
 		}
 	}
 
 	void update_sliders(lerp_visualizer& app, entt::registry& reg)
 	{
+		auto& input = reg.ctx().at<fae::Input>();
 		for (auto&& [entity, slider] : reg.view<Slider>().each())
 		{
 			slider.rectangle.x = slider.position.x - slider.width * .5f + slider.width * slider.value - slider.rectangle.width * .5f;
 			slider.rectangle.y = slider.position.y - slider.rectangle.height * .5f;
 
-			if (CheckCollisionPointRec(GetMousePosition(), slider.rectangle) && IsMouseButtonDown(MOUSE_BUTTON_LEFT))
+			if (CheckCollisionPointRec(input.mousePosition, slider.rectangle) && input.IsMouseButtonDown(MOUSE_BUTTON_LEFT))
 			{
-				float mouseDX = GetMouseDelta().x;
-				float mouseDY = GetMouseDelta().y;
+				float mouseDX = input.mouseDelta.x;
+				float mouseDY = input.mouseDelta.y;
 				float sliderDX = mouseDX / slider.width;
 				float newSliderValue = slider.value + sliderDX;
 				float clampedSliderValue = Clamp(newSliderValue, 0, 1);
 				slider.value = clampedSliderValue;
-				SetMousePosition(GetMousePosition().x - (newSliderValue - clampedSliderValue) * slider.width, GetMousePosition().y - mouseDY);
+				fae::set_mouse_position(reg, { input.mousePosition.x - (newSliderValue - clampedSliderValue) * slider.width, input.mousePosition.y - mouseDY });
 			}
 		}
 	}
@@ -112,10 +135,13 @@ struct lerp_visualizer : public fae::application
 	{
 		registry.ctx().emplace<fae::WindowDescriptor>("Lerp Visualizer");
 		plugins.emplace(fae::rendering_plugin);
+		plugins.emplace(fae::time_plugin);
+		plugins.emplace(fae::input_plugin);
+		plugins.emplace(fae::profiler_plugin);
 		systems.start.emplace<&lerp_visualizer::setup>(*this);
-		systems.update_controlled_gameobject.emplace<&lerp_visualizer::update_sliders>(*this);
+		systems.update_controlled_gameobject.emplace<&lerp_visualizer::update_sliders, fae::main_thread>(*this);
 		systems.update_controlled_gameobject.emplace<&lerp_visualizer::update_lerp_point>(*this);
-		systems.update_controlled_gameobject.emplace<&lerp_visualizer::draw_points>(*this);
-		systems.update_controlled_gameobject.emplace<&lerp_visualizer::draw_sliders>(*this);
+		systems.render.emplace<&lerp_visualizer::draw_points, fae::main_thread>(*this);
+		systems.render.emplace<&lerp_visualizer::draw_sliders, fae::main_thread>(*this);
 	}
 };
\ No newline at end of file
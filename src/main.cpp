@@ -9,39 +9,70 @@
 //}
 
 //#include "sandbox/sandbox.h"
-//// sandbox (cellular automata)
-//int main()
+//// sandbox (cellular automata), --storage entities [--verify-index] for the entity per particle backend,
+//// --serial to keep cell updates off the pool, --deterministic for the same outcome on any number of threads.
+//// --world size [--region path] [--resident chunks] [--active-radius chunks] to page a large world through a region file.
+//// Keys 1-8 pick stone, sand, water, fire, smoke, oil, lava and acid
+//int main(int argc, char** argv)
 //{
 //	sandbox_application app;
+//	sandbox_application::configure(app.registry, argc, argv);
+//	fae::configure_headless(app.registry, argc, argv);
+//	fae::configure_profiler(app.registry, argc, argv);
 //	app.run();
 //}
 
 //#include "rope/rope.h"
 //// rope simulation
-//int main()
+//int main(int argc, char** argv)
 //{
 //	rope_simulation app;
+//	fae::configure_headless(app.registry, argc, argv);
+//	fae::configure_profiler(app.registry, argc, argv);
 //	app.run();
 //}
 
 //#include "perlin/perlin.h"
 //// perlin noise visualizer
-//int main()
+//int main(int argc, char** argv)
 //{
 //	perlin app;
+//	fae::configure_headless(app.registry, argc, argv);
+//	fae::configure_profiler(app.registry, argc, argv);
 //	app.run();
 //}
 
 //#include "lerp_visualizer/lerp_visualizer.h"
-//int main()
+//int main(int argc, char** argv)
 //{
 //	lerp_visualizer app;
+//	fae::configure_headless(app.registry, argc, argv);
+//	fae::configure_profiler(app.registry, argc, argv);
+//	app.run();
+//}
+
+//#include "fluid/fluid3d.h"
+//// 3d fluid, shown as a slice or a max intensity projection along z
+//// takes --size N [--depth N] [--scale pixels] [--iterations sweeps] [--timestep dt] [--mip]
+//int main(int argc, char** argv)
+//{
+//	fluid3d app;
+//	fluid3d::configure(app.registry, argc, argv);
+//	fae::configure_headless(app.registry, argc, argv);
+//	fae::configure_profiler(app.registry, argc, argv);
 //	app.run();
 //}
 
 #include "fluid/fluid.h"
-int main()
+// pass --headless [--frames N] [--dt seconds] [--snapshot file.png] to any demo to run it without a window,
+// --trace file.json to write a Chrome trace of every system (F3 toggles the profiler overlay)
+// the fluid also takes --size N [--scale pixels] [--iterations sweeps] [--timestep dt] [--bfloat16] [--fused-advection] [--dye] [--sparse] [--tracers count]
+// and --record file [--record-encoding raw|quantized|delta] to stream every step to a file, --replay file to scrub through one
+int main(int argc, char** argv)
 {
 	fluid app;
+	fluid::configure(app.registry, argc, argv);
+	fae::configure_headless(app.registry, argc, argv);
+	fae::configure_profiler(app.registry, argc, argv);
 	app.run();
 }
\ No newline at end of file
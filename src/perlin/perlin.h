@@ -120,29 +120,58 @@ struct perlin : public fae::application
 	float speedScalar = 1.f;
 	float pixelSize = 4.f;
 
+	// one pixel per noise sample, scaled up by pixelSize when drawn
+	fae::PixelGrid pixels;
+	Camera2D camera = { { 0, 0 }, { 0, 0 }, 0, 1 };
+
 	void setup(perlin& app, entt::registry& reg)
 	{
 		reg.ctx().at<fae::Renderer>().clearColor = BLACK;
+		auto& window = reg.ctx().at<fae::WindowDescriptor>();
+		app.pixels.Resize(window.width / app.pixelSize, window.height / app.pixelSize);
+		reg.ctx().at<fae::ActiveCamera2D>().camera = &app.camera;
 	}
 
-	void draw_noise(perlin& app, entt::registry& reg)
+	void update_noise(perlin& app, entt::registry& reg)
 	{
-		auto& window = reg.ctx().at<fae::WindowDescriptor>();
-		for (size_t i = 0; i < window.width / app.pixelSize; i++)
+		auto& time = reg.ctx().at<fae::Time>();
+		float offset = time.elapsed * app.speedScalar;
+		// only samples on screen are computed, the rest of the grid keeps stale values that are never drawn
+		auto cells = fae::visible_cells(reg, { 0, 0 }, app.pixelSize, app.pixels.width, app.pixels.height);
+		for (int j = cells.yBegin; j < cells.yEnd; j++)
 		{
-			for (size_t j = 0; j < window.height / app.pixelSize; j++)
+			for (int i = cells.xBegin; i < cells.xEnd; i++)
 			{
-				unsigned char value = app.noise(i + GetTime() * app.speedScalar, j + GetTime() * app.speedScalar, 0.5) * 255;
-				DrawRectangle(i * app.pixelSize, j * app.pixelSize, app.pixelSize, app.pixelSize, { value, value, value, 255 });
+				unsigned char value = app.noise(i + offset, j + offset, 0.5) * 255;
+				app.pixels.At(i, j) = { value, value, value, 255 };
 			}
 		}
 	}
 
+	void draw_noise(perlin& app, entt::registry& reg)
+	{
+		auto cells = fae::visible_cells(reg, { 0, 0 }, app.pixelSize, app.pixels.width, app.pixels.height);
+		fae::draw_pixel_grid(app.pixels, { 0, 0 }, app.pixelSize, cells);
+	}
+
+	void cleanup(perlin& app, entt::registry& reg)
+	{
+		fae::export_headless_snapshot(reg, app.pixels);
+		fae::unload_pixel_grid(app.pixels);
+	}
+
 	perlin()
 	{
 		registry.ctx().emplace<fae::WindowDescriptor>("Perlin Noise Visualizer");
+		registry.ctx().emplace<fae::Camera2DController>();
 		plugins.emplace(fae::rendering_plugin);
+		plugins.emplace(fae::time_plugin);
+		plugins.emplace(fae::input_plugin);
+		plugins.emplace(fae::camera2d_plugin);
+		plugins.emplace(fae::profiler_plugin);
 		systems.start.emplace<&perlin::setup>(*this);
-		systems.update_controlled_gameobject.emplace<&perlin::draw_noise>(*this);
+		systems.update_controlled_gameobject.emplace<&perlin::update_noise>(*this);
+		systems.render.emplace<&perlin::draw_noise, fae::main_thread>(*this);
+		systems.stop.emplace<&perlin::cleanup, fae::main_thread>(*this);
 	}
 };
\ No newline at end of file
@@ -18,10 +18,23 @@ struct rope_simulation : public fae::application
 		std::vector<b2Joint*> joints;
 	};
 
+	// headless default: sweep the cursor over the anchors of every rope, pressing the button on the second pass
+	static void headless_script(size_t frame, fae::Input& input)
+	{
+		size_t period = 240;
+		float t = (frame % period) / (float)period;
+		input.mousePosition = { 256.f + t * 128.f * 3, 128.f + 128.f * ((frame / period) % 4) };
+		input.mouseDown[MOUSE_BUTTON_LEFT] = (frame / period) % 2 == 1;
+	}
+
 	void setup(rope_simulation& app, entt::registry& reg)
 	{
 		reg.ctx().at<fae::Renderer>().clearColor = BLACK;
 		reg.ctx().emplace<Physics>();
+		if (auto headless = reg.ctx().find<fae::HeadlessDescriptor>(); headless && !headless->script)
+		{
+			headless->script = headless_script;
+		}
 	}
 
 	void setup_rope_grid(rope_simulation& app, entt::registry& reg)
@@ -76,7 +89,7 @@ struct rope_simulation : public fae::application
 		auto& physics = reg.ctx().at<Physics>();
 		for (auto&& [entity, rope] : reg.view<Rope>().each())
 		{
-			for (size_t i = 1; i < rope.bodies.N(); i++)
+			for (size_t i = 1; i < rope.bodies.size(); i++)
 			{
 				b2RevoluteJointDef jointDef;
 				jointDef.Initialize(rope.bodies[i - 1], rope.bodies[i], rope.bodies[i - 1]->GetWorldCenter());
@@ -90,22 +103,30 @@ struct rope_simulation : public fae::application
 	void update_physics(rope_simulation& app, entt::registry& reg)
 	{
 		auto& physics = reg.ctx().at<Physics>();
-		float timeStep = 1.0f / 60.0f;
-		physics.world.Step(timeStep, 6, 2);
+		auto& fixed = reg.ctx().at<fae::FixedTimestep>();
+		physics.world.Step(fixed.dt, 6, 2);
 	}
 
 	void draw_ropes(rope_simulation& app, entt::registry& reg)
 	{
-		auto& physics = reg.ctx().at<Physics>();
+		auto& input = reg.ctx().at<fae::Input>();
+		auto& visible = reg.ctx().at<fae::VisibleRegion>();
 		for (auto&& [entity, rope] : reg.view<const Rope>().each())
 		{
 			for (auto& body : rope.staticBodies)
 			{
-				DrawCircle(body->GetPosition().x, body->GetPosition().y, 16, WHITE);
+				Vector2 bodyPosition = { body->GetPosition().x, body->GetPosition().y };
+				if (!visible.Contains(bodyPosition, 16)) continue;
+				bool hovered = CheckCollisionPointCircle(input.mousePosition, bodyPosition, 16);
+				DrawCircle(bodyPosition.x, bodyPosition.y, 16, hovered ? RED : WHITE);
 			}
 			for (auto& joint : rope.joints)
 			{
-				DrawLineEx({ joint->GetBodyA()->GetPosition().x, joint->GetBodyA()->GetPosition().y }, { joint->GetBodyB()->GetPosition().x, joint->GetBodyB()->GetPosition().y }, 8, WHITE);
+				Vector2 a = { joint->GetBodyA()->GetPosition().x, joint->GetBodyA()->GetPosition().y };
+				Vector2 b = { joint->GetBodyB()->GetPosition().x, joint->GetBodyB()->GetPosition().y };
+				Rectangle bounds = { fminf(a.x, b.x) - 4, fminf(a.y, b.y) - 4, fabsf(a.x - b.x) + 8, fabsf(a.y - b.y) + 8 };
+				if (!visible.Overlaps(bounds)) continue;
+				DrawLineEx(a, b, 8, WHITE);
 			}
 			/*for (auto& body : rope.dynamicBodies)
 			{
@@ -117,24 +138,23 @@ struct rope_simulation : public fae::application
 	void destroy_ropes_with_mouse(rope_simulation& app, entt::registry& reg)
 	{
 		auto& physics = reg.ctx().at<Physics>();
+		auto& input = reg.ctx().at<fae::Input>();
+		if (!input.IsMouseButtonDown(MOUSE_BUTTON_LEFT)) return;
 
+		auto& arena = reg.ctx().at<fae::FrameArena>();
 		for (auto&& [entity, rope] : reg.view<Rope>().each())
 		{
-			std::vector<b2Body*> deletedBodies;
+			std::pmr::vector<b2Body*> deletedBodies(&arena);
 			for (auto& staticBody : rope.staticBodies)
 			{
 				Vector2 bodyPosition = { staticBody->GetPosition().x, staticBody->GetPosition().y };
-				if (CheckCollisionPointCircle(GetMousePosition(), bodyPosition, 16))
+				if (CheckCollisionPointCircle(input.mousePosition, bodyPosition, 16))
 				{
-					DrawCircle(bodyPosition.x, bodyPosition.y, 16, RED);
-					if (IsMouseButtonDown(MOUSE_BUTTON_LEFT))
-					{
-						deletedBodies.push_back(staticBody);
-					}
+					deletedBodies.push_back(staticBody);
 				}
 			}
 
-			std::vector<b2Joint*> deletedJoints;
+			std::pmr::vector<b2Joint*> deletedJoints(&arena);
 
 			for (auto& body : deletedBodies)
 			{
@@ -168,11 +188,15 @@ struct rope_simulation : public fae::application
 	{
 		registry.ctx().emplace<fae::WindowDescriptor>("Rope Simulation (Box2D)");
 		plugins.emplace(fae::rendering_plugin);
+		plugins.emplace(fae::time_plugin);
+		plugins.emplace(fae::input_plugin);
+		plugins.emplace(fae::camera2d_plugin);
+		plugins.emplace(fae::profiler_plugin);
 		systems.start.emplace<&rope_simulation::setup>(*this);
 		systems.start.emplace<&rope_simulation::setup_rope_grid>(*this);
 		systems.start.emplace<&rope_simulation::setup_rope_joints>(*this);
-		systems.update_controlled_gameobject.emplace<&rope_simulation::update_physics>(*this);
-		systems.update_controlled_gameobject.emplace<&rope_simulation::draw_ropes>(*this);
+		systems.fixedUpdate.emplace<&rope_simulation::update_physics>(*this);
 		systems.update_controlled_gameobject.emplace<&rope_simulation::destroy_ropes_with_mouse>(*this);
+		systems.render.emplace<&rope_simulation::draw_ropes, fae::main_thread>(*this);
 	}
 };
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 #include "../fae/fae.h"
 #include "sandbox_components.h"
-#include "sandbox_systems.h"
+#include "sandbox_materials.h"
+#include "sandbox_cells.h"
+#include "sandbox_paging.h"
 #include "sandbox_particle_factories.h"
+#include "sandbox_systems.h"
 #include "sandbox_application.h"
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 #include "sandbox.h"
+#include <cstdlib>
+#include <cstring>
 
 /// <summary>
 /// The classic sandbox simulation with cellular automata
@@ -10,15 +12,67 @@ struct sandbox_application : public fae::application
 public:
 	ParticleGrid* grid = nullptr;
 	ParticleWorld* world = nullptr;
+	Camera2D camera = { { 0, 0 }, { 0, 0 }, 0, 1 };
 
 	// resources
 public:
+	struct Descriptor
+	{
+		ParticleStorage storage = ParticleStorage::cells;
+		// see ParticleGrid::verifyIndex
+		bool verifyIndex = false;
+		// update cells on the simulation thread alone instead of the scheduler's pool
+		bool serial = false;
+		// see ParticleGrid::deterministic
+		bool deterministic = false;
+		// cells per side, 0 keeps ParticleGrid's. A world size pages the grid through pager.regionPath
+		size_t worldSize = 0;
+		// cells are addressed with ints and chunks with uint32_t, and this is 1024^2 chunks of bookkeeping already
+		static constexpr size_t maxWorldSize = 65536;
+		ParticlePager pager;
+	};
+
 	struct Selection
 	{
-		std::function<entt::entity(entt::registry& reg)> selectedParticleFactory = stone;
+		ParticleMaterial selectedMaterial = ParticleMaterial::stone;
 		size_t selection = 1;
 	};
 
+	/// <summary>
+	/// Reads [--storage entities|cells] [--verify-index] [--serial] [--deterministic] and
+	/// [--world size [--region path] [--resident chunks] [--active-radius chunks]] from the command line.
+	/// </summary>
+	static void configure(entt::registry& reg, int argc, char** argv)
+	{
+		Descriptor descriptor;
+		for (int i = 1; i < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--storage") == 0 && i + 1 < argc)
+			{
+				descriptor.storage = std::strcmp(argv[++i], "entities") == 0 ? ParticleStorage::entities : ParticleStorage::cells;
+			}
+			else if (std::strcmp(argv[i], "--verify-index") == 0) descriptor.verifyIndex = true;
+			else if (std::strcmp(argv[i], "--serial") == 0) descriptor.serial = true;
+			else if (std::strcmp(argv[i], "--deterministic") == 0) descriptor.deterministic = true;
+			else if (std::strcmp(argv[i], "--world") == 0 && i + 1 < argc) descriptor.worldSize = std::min<size_t>(std::strtoull(argv[++i], nullptr, 10), Descriptor::maxWorldSize);
+			else if (std::strcmp(argv[i], "--region") == 0 && i + 1 < argc) descriptor.pager.regionPath = argv[++i];
+			else if (std::strcmp(argv[i], "--resident") == 0 && i + 1 < argc) descriptor.pager.maxResidentChunks = std::strtoull(argv[++i], nullptr, 10);
+			else if (std::strcmp(argv[i], "--active-radius") == 0 && i + 1 < argc) descriptor.pager.activeRadius = std::max(0, std::atoi(argv[++i]));
+		}
+		reg.ctx().emplace<Descriptor>(std::move(descriptor));
+	}
+
+	// headless default: pour sand and water from two spots at the top, switching material every few seconds
+	static void headless_script(size_t frame, fae::Input& input)
+	{
+		size_t period = 180;
+		input.keysDown.reset();
+		input.keysDown[(frame / period) % 2 == 0 ? KEY_TWO : KEY_THREE] = frame % period == 0;
+		float x = (frame / period) % 2 == 0 ? 256.f : 768.f;
+		input.mousePosition = { x + (frame % 16) * 8.f, 64.f };
+		input.mouseDown[MOUSE_BUTTON_LEFT] = true;
+	}
+
 	// systems
 public:
 	void setup(sandbox_application& app, entt::registry& reg)
@@ -26,10 +80,37 @@ public:
 		// set clear color to black
 		auto& renderer = reg.ctx().at<fae::Renderer>();
 		renderer.clearColor = BLACK;
+		reg.ctx().at<fae::ActiveCamera2D>().camera = &app.camera;
 
 		// setup grid & world
 		auto gridEntity = reg.create();
 		auto& grid = reg.emplace<ParticleGrid>(gridEntity);
+		grid.pool = &reg.ctx().at<fae::application&>().scheduler.pool();
+		if (auto descriptor = reg.ctx().find<Descriptor>())
+		{
+			grid.storage = descriptor->storage;
+			grid.verifyIndex = descriptor->verifyIndex;
+			grid.deterministic = descriptor->deterministic;
+			if (descriptor->serial) grid.pool = nullptr;
+			if (descriptor->worldSize > 0)
+			{
+				size_t defaultSize = grid.N;
+				grid.N = descriptor->worldSize;
+				if (grid.storage == ParticleStorage::entities) TraceLog(LOG_WARNING, "SANDBOX: only cells storage pages, using it for the world");
+				auto& pager = reg.emplace<ParticlePager>(gridEntity, std::move(descriptor->pager));
+				if (!pager.open(grid))
+				{
+					// the whole world in memory is what paging was for, fall back to the usual grid instead
+					TraceLog(LOG_WARNING, "SANDBOX: could not page the world, using a %zu^2 grid in memory", defaultSize);
+					reg.remove<ParticlePager>(gridEntity);
+					grid.N = defaultSize;
+					grid.paged = false;
+					grid.chunks.clear();
+				}
+			}
+		}
+		grid.ResizeCells();
+		grid.ResizeIndex();
 		app.grid = &grid;
 		reg.emplace<ParticleGridRenderer>(gridEntity, false, (size_t)8);
 
@@ -39,50 +120,49 @@ public:
 
 		// setup resources
 		reg.ctx().emplace<Selection>();
+		if (auto headless = reg.ctx().find<fae::HeadlessDescriptor>(); headless && !headless->script)
+		{
+			headless->script = headless_script;
+		}
 	}
 
 	void update_particle_selection(sandbox_application& app, entt::registry& reg)
 	{
 		auto& selection = reg.ctx().at<Selection>();
-		if (IsKeyReleased(KEY_ONE))
+		auto& input = reg.ctx().at<fae::Input>();
+		// 1 for stone, 2 for sand and so on through the materials
+		for (int key = KEY_ONE; key <= KEY_EIGHT; key++)
 		{
-			selection.selectedParticleFactory = stone;
-		}
-		else if (IsKeyReleased(KEY_TWO))
-		{
-			selection.selectedParticleFactory = sand;
-		}
-		else if (IsKeyReleased(KEY_THREE))
-		{
-			selection.selectedParticleFactory = water;
+			if (!input.IsKeyReleased(key)) continue;
+			selection.selection = key - KEY_ZERO;
+			selection.selectedMaterial = ParticleMaterial(selection.selection);
+			TraceLog(LOG_INFO, "SANDBOX: selected %s", material_info(selection.selectedMaterial).name);
 		}
 	}
 
 	void create_particle_on_selection(sandbox_application& app, entt::registry& reg)
 	{
-		if (IsMouseButtonDown(MOUSE_BUTTON_LEFT))
+		auto& input = reg.ctx().at<fae::Input>();
+		if (input.IsMouseButtonDown(MOUSE_BUTTON_LEFT))
 		{
 			for (auto&& [entity, grid, gridRenderer] : reg.view<ParticleGrid, const ParticleGridRenderer>().each())
 			{
-				auto mouseScreenPos = GetMousePosition();
-				auto mouseGridPos = gridRenderer.ScreenToGrid(mouseScreenPos.x, mouseScreenPos.y);
+				auto mouseWorldPos = fae::screen_to_world(reg, input.mousePosition);
+				auto mouseGridPos = gridRenderer.WorldToGrid(mouseWorldPos.x, mouseWorldPos.y);
 				if (!grid.InBounds(mouseGridPos.x, mouseGridPos.y)) continue;
-
-				// destroy particle if any existing there
-				auto particleToDelete = grid.GetParticleAt(mouseGridPos.x, mouseGridPos.y);
-				if (particleToDelete != entt::null && reg.valid(particleToDelete))
+				if (grid.storage == ParticleStorage::cells)
 				{
-					grid.particles.erase(particleToDelete);
-					reg.destroy(particleToDelete);
+					place_material(grid, mouseGridPos.x, mouseGridPos.y, reg.ctx().at<Selection>().selectedMaterial);
+					continue;
 				}
 
-				// create particle at mouse position
+				// create particle at mouse position, destroying the one there if any
 				// TODO make diamond shape around selection N
-				auto& selection = reg.ctx().at<Selection>();
-				auto particleEntity = selection.selectedParticleFactory(reg);
+				auto particleEntity = particle(reg, reg.ctx().at<Selection>().selectedMaterial);
 				auto& transform = reg.get<ParticleTransform>(particleEntity);
-				transform.position = mouseGridPos;
-				grid.particles.insert(particleEntity);
+				transform.position = { floorf(mouseGridPos.x), floorf(mouseGridPos.y) };
+				auto particleToDelete = grid.Place(particleEntity, mouseGridPos.x, mouseGridPos.y);
+				if (particleToDelete != entt::null && reg.valid(particleToDelete)) reg.destroy(particleToDelete);
 				auto particle = reg.try_get<ParticleBehavior>(particleEntity);
 				if (particle)
 				{
@@ -95,16 +175,21 @@ public:
 
 	void delete_particle_on_selection(sandbox_application& app, entt::registry& reg)
 	{
-		if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT) && !IsMouseButtonDown(MOUSE_BUTTON_LEFT))
+		auto& input = reg.ctx().at<fae::Input>();
+		if (input.IsMouseButtonDown(MOUSE_BUTTON_RIGHT) && !input.IsMouseButtonDown(MOUSE_BUTTON_LEFT))
 		{
 			for (auto&& [entity, grid, gridRenderer] : reg.view<ParticleGrid, const ParticleGridRenderer>().each())
 			{
-				auto mouseScreenPos = GetMousePosition();
-				auto mouseGridPos = gridRenderer.ScreenToGrid(mouseScreenPos.x, mouseScreenPos.y);
+				auto mouseWorldPos = fae::screen_to_world(reg, input.mousePosition);
+				auto mouseGridPos = gridRenderer.WorldToGrid(mouseWorldPos.x, mouseWorldPos.y);
 				if (!grid.InBounds(mouseGridPos.x, mouseGridPos.y)) continue;
-				auto particle = grid.GetParticleAt(mouseGridPos.x, mouseGridPos.y);
-				if (particle == entt::null && !reg.valid(particle)) continue;
-				grid.particles.erase(particle);
+				if (grid.storage == ParticleStorage::cells)
+				{
+					place_material(grid, mouseGridPos.x, mouseGridPos.y, ParticleMaterial::empty);
+					continue;
+				}
+				auto particle = grid.Remove(mouseGridPos.x, mouseGridPos.y);
+				if (particle == entt::null || !reg.valid(particle)) continue;
 				reg.destroy(particle);
 			}
 		}
@@ -112,12 +197,21 @@ public:
 
 	sandbox_application()
 	{
-		registry.ctx().emplace<WindowDescriptor>("Sandbox (Cellular Automata)");
+		registry.ctx().emplace<fae::WindowDescriptor>("Sandbox (Cellular Automata)");
+		registry.ctx().emplace<fae::Camera2DController>();
+		scheduler.mode = fae::scheduler::execution_mode::parallel;
 		plugins.emplace(fae::rendering_plugin);
+		plugins.emplace(fae::time_plugin);
+		plugins.emplace(fae::input_plugin);
+		plugins.emplace(fae::camera2d_plugin);
 		plugins.emplace(sandbox_plugin);
+		plugins.emplace(fae::profiler_plugin);
 		systems.start.emplace<&sandbox_application::setup>(*this);
-		systems.update_controlled_gameobject.emplace<&sandbox_application::update_particle_selection>(*this);
-		systems.update_controlled_gameobject.emplace<&sandbox_application::create_particle_on_selection>(*this);
-		systems.update_controlled_gameobject.emplace<&sandbox_application::delete_particle_on_selection>(*this);
+		// the app itself is only read, placing and removing particles touches every particle component
+		systems.update_controlled_gameobject.emplace<&sandbox_application::update_particle_selection, const sandbox_application, const fae::Input, Selection>(*this);
+		systems.update_controlled_gameobject.emplace<&sandbox_application::create_particle_on_selection, const sandbox_application, const fae::Input, const fae::ActiveCamera2D, const Selection,
+			ParticleGrid, const ParticleGridRenderer, ParticleTransform, ParticleRenderer, ParticleRigidBody, ParticleBehavior>(*this);
+		systems.update_controlled_gameobject.emplace<&sandbox_application::delete_particle_on_selection, const sandbox_application, const fae::Input, const fae::ActiveCamera2D,
+			ParticleGrid, const ParticleGridRenderer, ParticleTransform, ParticleRenderer, ParticleRigidBody, ParticleBehavior>(*this);
 	}
 };
\ No newline at end of file
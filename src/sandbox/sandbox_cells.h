@@ -0,0 +1,227 @@
+#pragma once
+#include "sandbox.h"
+#include <climits>
+
+// the material's color darkened by the cell's shade, or by a new one every update for materials that flicker
+Color cell_color(const ParticleCell& cell, int x, int y, uint32_t update)
+{
+	auto& info = material_info(cell.material);
+	Color color = info.color;
+	int darken = info.flickers ? cell_random(x, y, update) % (info.colorVariance + 1) : cell.shade;
+	color.r = (unsigned char)(color.r * (255 - darken) / 255);
+	color.g = (unsigned char)(color.g * (255 - darken) / 255);
+	color.b = (unsigned char)(color.b * (255 - darken) / 255);
+	return color;
+}
+
+// turns the cell at x, y into a fresh particle of material, counted as updated by the running update
+void set_material(const ParticleGrid& grid, ParticleCell& cell, int x, int y, ParticleMaterial material)
+{
+	auto& info = material_info(material);
+	cell = { material };
+	// hashed from the position alone so refilling a spot looks the same
+	cell.shade = uint8_t(cell_random(x, y, 0) % (info.colorVariance + 1));
+	cell.state = uint8_t(std::min(255, info.lifetime + int(cell_random(x, y, grid.updates) % (info.lifetimeVariance + 1))));
+	cell.flags = grid.parity;
+}
+
+// replaces whatever is at x, y, the grid has to have cells storage
+void place_material(ParticleGrid& grid, size_t x, size_t y, ParticleMaterial material)
+{
+	grid.ResizeCells();
+	// a paged out chunk keeps what it was written out with
+	if (!grid.Resident(x, y)) return;
+	// between updates that reads as updated by the last one, so it moves on the next one
+	set_material(grid, grid.CellAt(x, y), (int)x, (int)y, material);
+	// with the cells around it, they may fall into a spot just emptied
+	grid.MarkDirty({ (int)x - 1, (int)y - 1, (int)x + 2, (int)y + 2 });
+}
+
+namespace cells
+{
+	// grows touched to take in the cell at x, y
+	void touch(fae::CellRange& touched, int x, int y)
+	{
+		touched = { std::min(touched.xBegin, x), std::min(touched.yBegin, y), std::max(touched.xEnd, x + 1), std::max(touched.yEnd, y + 1) };
+	}
+
+	// the cell dx, dy away from cell, which is at x, y, null outside the grid or in a paged out chunk, which are walls alike
+	ParticleCell* neighbour(ParticleGrid& grid, ParticleCell& cell, int x, int y, int dx, int dy)
+	{
+		if (!grid.InBounds(x + dx, y + dy)) return nullptr;
+		// next door in the same chunk is a fixed offset away
+		constexpr int size = ParticleChunk::size;
+		int localX = x % size + dx;
+		int localY = y % size + dy;
+		if (localX >= 0 && localX < size && localY >= 0 && localY < size) return &cell + dx + dy * size;
+		return grid.ChunkAt(x + dx, y + dy).Resident() ? &grid.CellAt(x + dx, y + dy) : nullptr;
+	}
+
+	bool can_move(ParticleGrid& grid, ParticleCell& cell, int x, int y, int dx, int dy)
+	{
+		auto other = neighbour(grid, cell, x, y, dx, dy);
+		return other && material_info(other->material).density < material_info(cell.material).density;
+	}
+
+	// moves the particle in cell, at x, y, by dx, dy when that cell holds something lighter, swapping the two
+	bool try_move(ParticleGrid& grid, fae::CellRange& touched, ParticleCell& cell, int x, int y, int dx, int dy)
+	{
+		if (!can_move(grid, cell, x, y, dx, dy)) return false;
+		auto& other = *neighbour(grid, cell, x, y, dx, dy);
+		std::swap(cell, other);
+		other.flags = (other.flags & ~ParticleCell::updated) | grid.parity;
+		cell.flags = (cell.flags & ~ParticleCell::updated) | grid.parity;
+		touch(touched, x, y);
+		touch(touched, x + dx, y + dy);
+		return true;
+	}
+
+	// the first reaction of cell's material with one of the four cells next to it that rolls its chance
+	bool react(ParticleGrid& grid, fae::CellRange& touched, ParticleCell& cell, int x, int y, uint32_t& random)
+	{
+		constexpr int dxs[] = { 0, 1, 0, -1 };
+		constexpr int dys[] = { 1, 0, -1, 0 };
+		for (int i = 0; i < 4; i++)
+		{
+			int dx = dxs[i];
+			int dy = dys[i];
+			auto next = neighbour(grid, cell, x, y, dx, dy);
+			if (!next) continue;
+			auto& other = *next;
+			auto reaction = find_reaction(cell.material, other.material);
+			if (!reaction) continue;
+			// stays awake while it has something to react with, whether it does this update or not
+			touch(touched, x, y);
+			random = next_random(random);
+			if (!roll(random, reaction->chance)) continue;
+			// a side that stays what it was keeps its shade and what is left of its lifetime
+			if (other.material != reaction->neighbourBecomes) set_material(grid, other, x + dx, y + dy, reaction->neighbourBecomes);
+			if (cell.material != reaction->becomes) set_material(grid, cell, x, y, reaction->becomes);
+			touch(touched, x + dx, y + dy);
+			return true;
+		}
+		return false;
+	}
+
+	// touched takes in every cell that changed, or has to be looked at again next update
+	void update_cell(ParticleGrid& grid, fae::CellRange& touched, ParticleCell& cell, int x, int y)
+	{
+		if (cell.material == ParticleMaterial::empty) return;
+		if ((cell.flags & ParticleCell::updated) == grid.parity)
+		{
+			// moved or reacted this update, or a bit left over from sleeping through updates, either way give it the next one
+			touch(touched, x, y);
+			return;
+		}
+		// visited whether it moves or not, so only particles in asleep chunks are left with stale bits
+		cell.flags = (cell.flags & ~ParticleCell::updated) | grid.parity;
+		auto& info = material_info(cell.material);
+		uint32_t random = cell_random(x, y, grid.updates);
+		if (material_reacts[(size_t)cell.material] && react(grid, touched, cell, x, y, random)) return;
+		if (info.lifetime > 0)
+		{
+			// counting down keeps it awake
+			touch(touched, x, y);
+			if (cell.state == 0) return set_material(grid, cell, x, y, info.expiresInto);
+			cell.state--;
+		}
+
+		// which diagonal and side is tried first alternates every update, so piles don't lean one way
+		int side = grid.parity ? 1 : -1;
+		auto& moves = material_moves[(size_t)info.movement];
+		for (int i = 0; i < moves.count; i++)
+		{
+			if (i == moves.sideways && !roll(next_random(random), info.spread))
+			{
+				// held back this update, awake for the next one as long as it could go
+				for (; i < moves.count; i++)
+				{
+					if (can_move(grid, cell, x, y, moves.dx[i] * side, moves.dy[i])) return touch(touched, x, y);
+				}
+				return;
+			}
+			if (try_move(grid, touched, cell, x, y, moves.dx[i] * side, moves.dy[i])) return;
+		}
+	}
+
+	// the dirty cells of a chunk, rows from the bottom up so falling particles land in cells already updated,
+	// along them in the direction the parity picks. Returns what changed and everything next to it,
+	// which can move next update in this chunk or the ones around it
+	fae::CellRange update_chunk(ParticleGrid& grid, ParticleChunk& chunk)
+	{
+		constexpr int size = ParticleChunk::size;
+		auto dirty = chunk.dirty;
+		fae::CellRange touched = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+		for (int y = dirty.yEnd - 1; y >= dirty.yBegin; y--)
+		{
+			// dirty is inside the chunk, so its cells are a row of the chunk's array
+			ParticleCell* row = grid.CellsOf(chunk).data() + y % size * size;
+			for (int i = 0; i < dirty.Width(); i++)
+			{
+				int x = grid.parity ? dirty.xBegin + i : dirty.xEnd - 1 - i;
+				update_cell(grid, touched, row[x % size], x, y);
+			}
+		}
+		if (touched.Empty()) return {};
+		return { touched.xBegin - 1, touched.yBegin - 1, touched.xEnd + 1, touched.yEnd + 1 };
+	}
+
+	// chunks whose x and y are both even, then odd and even, even and odd, odd and odd. The chunks of a phase are
+	// a chunk apart and a particle moves at most one cell, so none of them reads or writes a cell another one does
+	void update_checkerboard(ParticleGrid& grid)
+	{
+		size_t chunks = grid.ChunksPerSide();
+		for (size_t phase = 0; phase < 4; phase++)
+		{
+			grid.phaseChunks.clear();
+			// in the serial order, which doesn't change the outcome within a phase
+			for (uint32_t c : grid.activeChunks)
+			{
+				if (c % chunks % 2 == phase % 2 && c / chunks % 2 == phase / 2 && !grid.chunks[c].Asleep()) grid.phaseChunks.push_back(c);
+			}
+
+			auto run = [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					auto& chunk = grid.chunks[grid.phaseChunks[i]];
+					chunk.touched = update_chunk(grid, chunk);
+				}
+			};
+			if (grid.pool) grid.pool->parallel_for(0, grid.phaseChunks.size(), 1, run);
+			else run(0, grid.phaseChunks.size());
+
+			// neighbours of a phase share the chunks around them, so marking waits for all of them
+			for (uint32_t c : grid.phaseChunks) grid.MarkDirty(grid.chunks[c].touched);
+		}
+	}
+
+	/// <summary>
+	/// Moves, reacts and ages every particle of a cells grid at most once, by the rows of materials and reactions.
+	/// Only the dirty cells of each active chunk are visited, so the cost follows how much is moving rather than how much there is.
+	/// On one thread chunk rows go from the bottom up like the cell rows inside them. With a pool, or deterministic,
+	/// chunks go in four checkerboard phases, which come out the same on any number of threads.
+	/// </summary>
+	void update(ParticleGrid& grid)
+	{
+		grid.ResizeCells();
+		grid.parity ^= ParticleCell::updated;
+		grid.updates++;
+		grid.awakeChunks = 0;
+		// inactive chunks keep collecting nextDirty until they are active again
+		for (uint32_t c : grid.activeChunks)
+		{
+			auto& chunk = grid.chunks[c];
+			chunk.dirty = chunk.nextDirty;
+			chunk.nextDirty = {};
+			grid.awakeChunks += !chunk.Asleep();
+		}
+
+		if (grid.pool || grid.deterministic) return update_checkerboard(grid);
+		for (uint32_t c : grid.activeChunks)
+		{
+			auto& chunk = grid.chunks[c];
+			if (!chunk.Asleep()) grid.MarkDirty(update_chunk(grid, chunk));
+		}
+	}
+}
\ No newline at end of file
@@ -1,14 +1,32 @@
 #pragma once
 #include "sandbox.h"
+#include <array>
+#include <cstdint>
+#include <unordered_set>
 
 struct ParticleGrid;
 struct ParticleWorld;
 
+enum class ParticleMaterial : uint8_t
+{
+	empty,
+	stone,
+	sand,
+	water,
+	fire,
+	smoke,
+	oil,
+	lava,
+	acid,
+	count,
+};
+
+// moves the particle the way its material's row of materials says, see update_particles
 struct ParticleBehavior
 {
 	ParticleGrid* grid;
 	ParticleWorld* world;
-	std::function<void(entt::registry&, entt::entity)> onUpdate = [&](auto&, auto) {};
+	ParticleMaterial material = ParticleMaterial::empty;
 };
 
 struct ParticleRenderer
@@ -33,20 +51,183 @@ struct ParticleWorld
 	Vector2 gravity = { 0, -9.8f };
 };
 
+// one cell of the dense backend, everything a particle needs without an entity
+struct ParticleCell
+{
+	ParticleMaterial material = ParticleMaterial::empty;
+	// ParticleCell::updated and whatever else a material needs to remember
+	uint8_t flags = 0;
+	// darkens the material's color a little, picked when the particle is placed
+	uint8_t shade = 0;
+	// updates left for materials with a lifetime
+	uint8_t state = 0;
+
+	// matches the grid's parity once the particle has moved this update
+	static constexpr uint8_t updated = 1;
+};
+
+/// <summary>
+/// A square of cells stored together, the unit cells storage updates, sleeps and pages in. Only the cells inside dirty are
+/// updated, a chunk with an empty one is asleep and costs nothing until something marks it from next door.
+/// </summary>
+struct ParticleChunk
+{
+	static constexpr int size = 64;
+	using Cells = std::array<ParticleCell, size * size>;
+	static constexpr uint32_t pagedOut = UINT32_MAX;
+
+	// which of the grid's pages holds the cells, pagedOut while a ParticlePager has them on disk
+	uint32_t page = pagedOut;
+	// what the running update goes through, in grid coordinates
+	fae::CellRange dirty;
+	// what the next one will, grown as cells move and particles are placed
+	fae::CellRange nextDirty;
+	// what the running update changed, for the checkerboard update to mark once the chunk's phase is over
+	fae::CellRange touched;
+
+	bool Asleep() const { return dirty.Empty(); }
+	bool Resident() const { return page != pagedOut; }
+};
+
+enum class ParticleStorage
+{
+	// an entity per particle with its components and behavior
+	entities,
+	// a ParticleCell per grid cell in ParticleChunks, updated in place by update_cells
+	cells,
+};
+
 struct ParticleGrid
 {
 	size_t N = 256;
+	ParticleStorage storage = ParticleStorage::cells;
 	std::unordered_set<entt::entity> particles;
+	// ChunksPerSide() squared, row-major, only with cells storage
+	std::vector<ParticleChunk> chunks;
+	// the cells of the resident chunks, one page per chunk unless paged
+	std::vector<ParticleChunk::Cells> pages;
+	// chunks update_cells goes through, chunk rows from the bottom up. Every chunk unless paged
+	std::vector<uint32_t> activeChunks;
+	// a ParticlePager decides which chunks have pages and are active, see ParticlePager::open
+	bool paged = false;
+	// flips every update_cells, see ParticleCell::updated
+	uint8_t parity = 0;
+	// counts update_cells, seeds the chances materials roll
+	uint32_t updates = 0;
+	// chunks that had anything to update in the last update_cells
+	size_t awakeChunks = 0;
+	// rebuild the entity index from the transforms every update_grids and warn when it had drifted, for debugging
+	bool verifyIndex = false;
+	// update chunks on the pool in a checkerboard, see cells::update
+	fae::thread_pool* pool = nullptr;
+	// use the checkerboard order on one thread too, so a run comes out the same whatever the thread count
+	bool deterministic = false;
+	// scratch for cells::update, the awake chunks of a checkerboard phase
+	std::vector<uint32_t> phaseChunks;
 
 	bool InBounds(size_t x, size_t y) const { return x < N&& y < N; }
 
+	size_t ChunksPerSide() const { return (N + ParticleChunk::size - 1) / ParticleChunk::size; }
+
+	// sizes the chunks to the grid, empty, when they don't match it yet. Paged grids get no pages, the pager hands them out
+	void ResizeCells()
+	{
+		size_t perSide = ChunksPerSide();
+		if (storage != ParticleStorage::cells || chunks.size() == perSide * perSide) return;
+		chunks.clear();
+		chunks.resize(perSide * perSide);
+		pages.clear();
+		activeChunks.clear();
+		if (paged) return;
+		pages.resize(chunks.size());
+		for (size_t cy = perSide; cy-- > 0;)
+		{
+			for (size_t cx = 0; cx < perSide; cx++)
+			{
+				uint32_t c = uint32_t(cx + cy * perSide);
+				chunks[c].page = c;
+				activeChunks.push_back(c);
+			}
+		}
+	}
+
+	ParticleChunk& ChunkAt(size_t x, size_t y) { return chunks[x / ParticleChunk::size + y / ParticleChunk::size * ChunksPerSide()]; }
+	const ParticleChunk& ChunkAt(size_t x, size_t y) const { return chunks[x / ParticleChunk::size + y / ParticleChunk::size * ChunksPerSide()]; }
+	ParticleChunk::Cells& CellsOf(const ParticleChunk& chunk) { return pages[chunk.page]; }
+	const ParticleChunk::Cells& CellsOf(const ParticleChunk& chunk) const { return pages[chunk.page]; }
+	// the cell has to be in a resident chunk
+	ParticleCell& CellAt(size_t x, size_t y) { return CellsOf(ChunkAt(x, y))[x % ParticleChunk::size + y % ParticleChunk::size * ParticleChunk::size]; }
+	const ParticleCell& CellAt(size_t x, size_t y) const { return CellsOf(ChunkAt(x, y))[x % ParticleChunk::size + y % ParticleChunk::size * ParticleChunk::size]; }
+	bool Resident(size_t x, size_t y) const { return InBounds(x, y) && ChunkAt(x, y).Resident(); }
+
+	// grows the next dirty rectangle of every chunk the cells overlap, waking the asleep ones
+	void MarkDirty(fae::CellRange cells)
+	{
+		cells = { std::max(cells.xBegin, 0), std::max(cells.yBegin, 0), std::min(cells.xEnd, (int)N), std::min(cells.yEnd, (int)N) };
+		if (cells.Empty()) return;
+		int size = ParticleChunk::size;
+		int perSide = (int)ChunksPerSide();
+		int cxBegin = cells.xBegin / size;
+		int cyBegin = cells.yBegin / size;
+		int cxLast = (cells.xEnd - 1) / size;
+		int cyLast = (cells.yEnd - 1) / size;
+		// almost every move stays inside one chunk
+		if (cxBegin == cxLast && cyBegin == cyLast) return grow(chunks[cxBegin + cyBegin * perSide].nextDirty, cells);
+		for (int cy = cyBegin; cy <= cyLast; cy++)
+		{
+			for (int cx = cxBegin; cx <= cxLast; cx++)
+			{
+				grow(chunks[cx + cy * perSide].nextDirty, { std::max(cells.xBegin, cx * size), std::max(cells.yBegin, cy * size), std::min(cells.xEnd, (cx + 1) * size), std::min(cells.yEnd, (cy + 1) * size) });
+			}
+		}
+	}
+
+	// sizes the entity index to the grid, empty, when it doesn't match it yet
+	void ResizeIndex()
+	{
+		if (storage == ParticleStorage::entities && posToParticle.size() != N * N) posToParticle.assign(N * N, entt::null);
+	}
+
 	entt::entity GetParticleAt(size_t x, size_t y) const {
-		if (!InBounds(x, y)) return entt::null;
-		return posToParticle.at(x).at(y);
+		if (!InBounds(x, y) || posToParticle.empty()) return entt::null;
+		return posToParticle[x + y * N];
+	}
+
+	// adds particle to the grid at x, y and returns whatever was there for the caller to destroy
+	entt::entity Place(entt::entity particle, size_t x, size_t y)
+	{
+		ResizeIndex();
+		auto previous = Remove(x, y);
+		posToParticle[x + y * N] = particle;
+		particles.insert(particle);
+		return previous;
+	}
+
+	// takes the particle at x, y out of the grid and returns it, entt::null when there was none
+	entt::entity Remove(size_t x, size_t y)
+	{
+		auto particle = GetParticleAt(x, y);
+		if (particle == entt::null) return particle;
+		posToParticle[x + y * N] = entt::null;
+		particles.erase(particle);
+		return particle;
+	}
+
+	// swaps the index entries of two cells, whoever moves their transforms calls this with them
+	void Swap(size_t x, size_t y, size_t otherX, size_t otherY)
+	{
+		std::swap(posToParticle[x + y * N], posToParticle[otherX + otherY * N]);
 	}
 
 private:
-	std::vector<std::vector<entt::entity>> posToParticle;
+	static void grow(fae::CellRange& range, fae::CellRange cells)
+	{
+		if (range.Empty()) range = cells;
+		else range = { std::min(range.xBegin, cells.xBegin), std::min(range.yBegin, cells.yBegin), std::max(range.xEnd, cells.xEnd), std::max(range.yEnd, cells.yEnd) };
+	}
+
+	// N * N row-major, kept current by Place, Remove and Swap
+	std::vector<entt::entity> posToParticle;
 	friend void update_grids(const void*, entt::registry& reg);
 };
 
@@ -54,13 +235,18 @@ struct ParticleGridRenderer
 {
 	bool drawDebugGridLines = false;
 	size_t particleSize = 1;
+	// one pixel per cell, filled by rasterize_grids and drawn scaled by particleSize
+	fae::PixelGrid pixels;
+	// the cells pixels holds, the whole grid unless it's paged, then only the visible ones
+	fae::CellRange pixelCells;
 
-	Vector2 ScreenToGrid(float x, float y) const
+	// world coordinates, go through fae::screen_to_world first for mouse positions
+	Vector2 WorldToGrid(float x, float y) const
 	{
 		return { x / particleSize, y / particleSize };
 	}
 
-	Vector2 GridToScreen(int x, int y) const
+	Vector2 GridToWorld(int x, int y) const
 	{
 		return { static_cast<float>(x * particleSize), static_cast<float>(y * particleSize) };
 	}
@@ -0,0 +1,138 @@
+#pragma once
+#include "sandbox.h"
+
+// how a material gets around, see material_moves
+enum class MaterialMovement : uint8_t
+{
+	// stays where it's put
+	none,
+	// down, then down a diagonal
+	powder,
+	// like powder, then sideways
+	liquid,
+	// up, then up a diagonal, then sideways
+	gas,
+};
+
+/// <summary>
+/// Everything the update needs to know about a material. Particles hold only their ParticleMaterial and both
+/// storages look the rest up here, so a new material is a row of materials and maybe a few reactions.
+/// </summary>
+struct MaterialInfo
+{
+	const char* name;
+	Color color;
+	// how much darker than color a particle can be, out of 255
+	uint8_t colorVariance;
+	// a particle only moves into a cell holding something lighter, empty weighs nothing
+	float density;
+	MaterialMovement movement;
+	// chance out of 255 that a particle which can't go its main way tries sideways, lower flows slower
+	uint8_t spread;
+	// updates until it turns into expiresInto, plus up to lifetimeVariance more, 0 lives forever. Only cells storage counts them
+	uint8_t lifetime;
+	uint8_t lifetimeVariance;
+	ParticleMaterial expiresInto;
+	// picks a new shade every update instead of keeping the one it was placed with
+	bool flickers;
+};
+
+// indexed by ParticleMaterial
+constexpr MaterialInfo materials[] =
+{
+	{ "empty", BLANK, 0, 0.f, MaterialMovement::none, 0, 0, 0, ParticleMaterial::empty, false },
+	{ "stone", GRAY, 32, 10.f, MaterialMovement::none, 0, 0, 0, ParticleMaterial::empty, false },
+	{ "sand", BEIGE, 32, 2.f, MaterialMovement::powder, 0, 0, 0, ParticleMaterial::empty, false },
+	{ "water", BLUE, 32, 1.f, MaterialMovement::liquid, 255, 0, 0, ParticleMaterial::empty, false },
+	{ "fire", ORANGE, 96, 0.2f, MaterialMovement::none, 0, 24, 32, ParticleMaterial::smoke, true },
+	{ "smoke", DARKGRAY, 48, 0.05f, MaterialMovement::gas, 192, 90, 120, ParticleMaterial::empty, false },
+	{ "oil", BROWN, 24, 0.8f, MaterialMovement::liquid, 160, 0, 0, ParticleMaterial::empty, false },
+	{ "lava", RED, 64, 3.f, MaterialMovement::liquid, 24, 0, 0, ParticleMaterial::empty, true },
+	{ "acid", LIME, 32, 1.1f, MaterialMovement::liquid, 224, 0, 0, ParticleMaterial::empty, false },
+};
+static_assert(std::size(materials) == (size_t)ParticleMaterial::count, "every material needs a row");
+
+constexpr const MaterialInfo& material_info(ParticleMaterial material) { return materials[(size_t)material]; }
+
+// the offsets a movement tries in order, for a side of 1. A side of -1 mirrors dx, so piles don't lean one way
+struct MaterialMoves
+{
+	int count;
+	// moves from here on are sideways, tried only when MaterialInfo::spread rolls
+	int sideways;
+	int dx[5];
+	int dy[5];
+};
+
+// indexed by MaterialMovement
+constexpr MaterialMoves material_moves[] =
+{
+	{ 0, 0, {}, {} },
+	{ 3, 3, { 0, 1, -1 }, { 1, 1, 1 } },
+	{ 5, 3, { 0, 1, -1, 1, -1 }, { 1, 1, 1, 0, 0 } },
+	{ 5, 3, { 0, 1, -1, 1, -1 }, { -1, -1, -1, 0, 0 } },
+};
+
+// when material is next to neighbour each update, with chance out of 255, the two turn into becomes and neighbourBecomes
+struct MaterialReaction
+{
+	ParticleMaterial material;
+	ParticleMaterial neighbour;
+	ParticleMaterial becomes;
+	ParticleMaterial neighbourBecomes;
+	uint8_t chance;
+};
+
+// only material looks for its neighbour, so each pair is listed once. Only cells storage reacts
+constexpr MaterialReaction reactions[] =
+{
+	// fire spreads along oil, and goes out in water
+	{ ParticleMaterial::fire, ParticleMaterial::oil, ParticleMaterial::fire, ParticleMaterial::fire, 48 },
+	{ ParticleMaterial::fire, ParticleMaterial::water, ParticleMaterial::smoke, ParticleMaterial::water, 255 },
+	// lava sets into stone under water, and lights oil
+	{ ParticleMaterial::lava, ParticleMaterial::water, ParticleMaterial::stone, ParticleMaterial::smoke, 128 },
+	{ ParticleMaterial::lava, ParticleMaterial::oil, ParticleMaterial::lava, ParticleMaterial::fire, 64 },
+	// acid is used up eating stone and sand, but not oil
+	{ ParticleMaterial::acid, ParticleMaterial::stone, ParticleMaterial::empty, ParticleMaterial::empty, 6 },
+	{ ParticleMaterial::acid, ParticleMaterial::sand, ParticleMaterial::empty, ParticleMaterial::empty, 16 },
+	{ ParticleMaterial::acid, ParticleMaterial::oil, ParticleMaterial::acid, ParticleMaterial::empty, 16 },
+};
+
+// whether material is the first of any reaction, worked out once per material at compile time
+constexpr auto material_reacts = []
+{
+	std::array<bool, (size_t)ParticleMaterial::count> reacts = {};
+	for (auto& reaction : reactions) reacts[(size_t)reaction.material] = true;
+	return reacts;
+}();
+
+constexpr const MaterialReaction* find_reaction(ParticleMaterial material, ParticleMaterial neighbour)
+{
+	for (auto& reaction : reactions)
+	{
+		if (reaction.material == material && reaction.neighbour == neighbour) return &reaction;
+	}
+	return nullptr;
+}
+
+// a hash of the position and update, so chances come out the same whichever thread rolls them
+constexpr uint32_t cell_random(int x, int y, uint32_t update)
+{
+	uint32_t h = uint32_t(x) * 73856093u ^ uint32_t(y) * 19349663u ^ update * 83492791u;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return h;
+}
+
+// the next number after random, for rolling more than one chance from a cell_random
+constexpr uint32_t next_random(uint32_t random)
+{
+	random ^= random << 13;
+	random ^= random >> 17;
+	random ^= random << 5;
+	return random;
+}
+
+// true chance out of 255 times, 0 never and 255 always
+constexpr bool roll(uint32_t random, uint8_t chance) { return random % 255 < chance; }
\ No newline at end of file
@@ -0,0 +1,254 @@
+#pragma once
+#include "sandbox.h"
+#include "../fae/mapped_file.h"
+#include <chrono>
+#include <filesystem>
+#include <random>
+
+/// <summary>
+/// Keeps a cells grid larger than memory on disk. Only the chunks within activeRadius of the camera's chunk are
+/// updated, and at most maxResidentChunks have pages, the least recently active written out to a memory mapped
+/// region file first and read back when the camera comes near them again. Chunks that are all empty take no room
+/// in the file, so an untouched world costs only its chunk bookkeeping.
+/// </summary>
+struct ParticlePager
+{
+	// chunks around the camera's chunk in each direction that are resident and updated
+	int activeRadius = 4;
+	// pages the grid keeps at most, raised to the active chunks when they're more
+	size_t maxResidentChunks = 1024;
+	// a file that doesn't exist yet, or empty for a new one in the temp directory. Removed again by close
+	std::string regionPath;
+
+	struct Stats
+	{
+		// active chunks that were resident already, and ones that had to be paged in
+		size_t hits = 0;
+		size_t misses = 0;
+		// misses that had cells in the region file, the rest were empty
+		size_t reads = 0;
+		// evicted chunks written to the region file, the rest were empty
+		size_t writes = 0;
+		size_t evictions = 0;
+		double pageInMs = 0;
+		double pageOutMs = 0;
+		double maxPageInMs = 0;
+		double maxPageOutMs = 0;
+
+		float HitRate() const { return hits + misses ? float(hits) / (hits + misses) : 1.f; }
+		double AvgPageInMs() const { return misses ? pageInMs / misses : 0; }
+		double AvgPageOutMs() const { return evictions ? pageOutMs / evictions : 0; }
+	};
+	Stats stats;
+
+	// creates an empty region file and makes grid paged, with every chunk out until the first stream.
+	// False without touching grid when regionPath is taken by another file or can't be mapped
+	bool open(ParticleGrid& grid)
+	{
+		close();
+		// the file is scratch and gets removed on close, so it never takes over one that was already there
+		std::error_code error;
+		if (regionPath.empty()) regionPath = unique_region_path();
+		if (std::filesystem::exists(regionPath, error) || error)
+		{
+			TraceLog(LOG_WARNING, "SANDBOX: region file %s already exists, not reusing it", regionPath.c_str());
+			return false;
+		}
+		slotCapacity = 0;
+		if (!grow_region(64))
+		{
+			std::filesystem::remove(regionPath, error);
+			return false;
+		}
+
+		grid.storage = ParticleStorage::cells;
+		grid.paged = true;
+		grid.chunks.clear();
+		grid.ResizeCells();
+		grid.pages.assign(std::max(maxResidentChunks, active_count()), {});
+		freePages.clear();
+		for (uint32_t page = (uint32_t)grid.pages.size(); page-- > 0;) freePages.push_back(page);
+		slots.assign(grid.chunks.size(), noSlot);
+		lastActive.assign(grid.chunks.size(), 0);
+		resident.clear();
+		freeSlots.clear();
+		slotCount = 0;
+		frame = 0;
+		stats = {};
+		return true;
+	}
+
+	void close()
+	{
+		if (!region.is_open()) return;
+		region.close();
+		std::error_code error;
+		std::filesystem::remove(regionPath, error);
+	}
+
+	ParticlePager() = default;
+	ParticlePager(ParticlePager&&) = default;
+	ParticlePager& operator=(ParticlePager&&) = default;
+	~ParticlePager() { close(); }
+
+	/// <summary>
+	/// Makes the chunks within activeRadius of the one holding x, y the grid's active chunks, paging in the ones
+	/// that aren't resident, after paging out the least recently active others to keep within maxResidentChunks.
+	/// </summary>
+	void stream(ParticleGrid& grid, int x, int y)
+	{
+		if (!region.is_open()) return;
+		frame++;
+		int perSide = (int)grid.ChunksPerSide();
+		int centerX = std::clamp(x / ParticleChunk::size, 0, perSide - 1);
+		int centerY = std::clamp(y / ParticleChunk::size, 0, perSide - 1);
+		grid.activeChunks.clear();
+		misses.clear();
+		// in the serial update order, chunk rows from the bottom up
+		for (int cy = std::min(centerY + activeRadius, perSide - 1); cy >= std::max(centerY - activeRadius, 0); cy--)
+		{
+			for (int cx = std::max(centerX - activeRadius, 0); cx <= std::min(centerX + activeRadius, perSide - 1); cx++)
+			{
+				uint32_t c = uint32_t(cx + cy * perSide);
+				grid.activeChunks.push_back(c);
+				lastActive[c] = frame;
+				if (grid.chunks[c].Resident()) stats.hits++;
+				else misses.push_back(c);
+			}
+		}
+		stats.misses += misses.size();
+
+		// evicting first hands its pages straight to the misses
+		size_t budget = grid.pages.size();
+		if (resident.size() + misses.size() > budget)
+		{
+			size_t excess = resident.size() + misses.size() - budget;
+			// the active ones were stamped this frame, so they sort last and stay
+			std::nth_element(resident.begin(), resident.begin() + excess, resident.end(), [&](uint32_t a, uint32_t b) { return lastActive[a] < lastActive[b]; });
+			for (size_t i = 0; i < excess; i++) page_out(grid, resident[i]);
+			resident.erase(resident.begin(), resident.begin() + excess);
+		}
+		for (uint32_t c : misses) page_in(grid, c);
+	}
+
+	size_t resident_count() const { return resident.size(); }
+	// bytes of the region file in use, chunks with cells in it
+	size_t region_bytes() const { return (slotCount - freeSlots.size()) * sizeof(ParticleChunk::Cells); }
+
+private:
+	static constexpr uint32_t noSlot = UINT32_MAX;
+	using clock = std::chrono::steady_clock;
+
+	fae::mapped_file region;
+	// slots of the region file, a chunk's cells each
+	size_t slotCapacity = 0;
+	uint32_t slotCount = 0;
+	std::vector<uint32_t> freeSlots;
+	// per chunk, where its cells are in the region file, noSlot when it was all empty or never paged out
+	std::vector<uint32_t> slots;
+	// per chunk, the stream it was last active in
+	std::vector<uint64_t> lastActive;
+	uint64_t frame = 0;
+	// chunks with pages, in no order
+	std::vector<uint32_t> resident;
+	std::vector<uint32_t> freePages;
+	// scratch for stream
+	std::vector<uint32_t> misses;
+
+	static std::string unique_region_path()
+	{
+		auto directory = std::filesystem::temp_directory_path();
+		std::random_device random;
+		for (;;)
+		{
+			auto path = directory / ("sandbox_region_" + std::to_string(random()) + ".bin");
+			std::error_code error;
+			if (!std::filesystem::exists(path, error)) return path.string();
+		}
+	}
+
+	size_t active_count() const { return size_t(activeRadius * 2 + 1) * (activeRadius * 2 + 1); }
+
+	// remaps the region file at capacity slots, the slots already written stay in the file
+	bool grow_region(size_t capacity)
+	{
+		region.close();
+		if (region.create(regionPath, capacity * sizeof(ParticleChunk::Cells)))
+		{
+			slotCapacity = capacity;
+			return true;
+		}
+		TraceLog(LOG_WARNING, "SANDBOX: could not map %zu bytes of region file %s", capacity * sizeof(ParticleChunk::Cells), regionPath.c_str());
+		if (slotCapacity > 0) region.create(regionPath, slotCapacity * sizeof(ParticleChunk::Cells));
+		return false;
+	}
+
+	ParticleChunk::Cells* slot_cells(uint32_t slot) { return (ParticleChunk::Cells*)region.writable_data() + slot; }
+
+	static double ms_since(clock::time_point begin) { return std::chrono::duration<double, std::milli>(clock::now() - begin).count(); }
+
+	void page_in(ParticleGrid& grid, uint32_t c)
+	{
+		auto begin = clock::now();
+		auto& chunk = grid.chunks[c];
+		chunk.page = freePages.back();
+		freePages.pop_back();
+		resident.push_back(c);
+		auto& cells = grid.CellsOf(chunk);
+		if (slots[c] != noSlot)
+		{
+			cells = *slot_cells(slots[c]);
+			stats.reads++;
+		}
+		else cells = {};
+
+		// particles next door treated it as a wall while it was out, so they and the whole chunk get another look
+		int size = ParticleChunk::size;
+		int perSide = (int)grid.ChunksPerSide();
+		int x = int(c % perSide) * size;
+		int y = int(c / perSide) * size;
+		grid.MarkDirty({ x - 1, y - 1, x + size + 1, y + size + 1 });
+
+		double ms = ms_since(begin);
+		stats.pageInMs += ms;
+		stats.maxPageInMs = std::max(stats.maxPageInMs, ms);
+	}
+
+	void page_out(ParticleGrid& grid, uint32_t c)
+	{
+		auto begin = clock::now();
+		auto& chunk = grid.chunks[c];
+		auto& cells = grid.CellsOf(chunk);
+		bool empty = std::all_of(cells.begin(), cells.end(), [](const ParticleCell& cell) { return cell.material == ParticleMaterial::empty; });
+		if (empty && slots[c] != noSlot)
+		{
+			freeSlots.push_back(slots[c]);
+			slots[c] = noSlot;
+		}
+		else if (!empty)
+		{
+			if (slots[c] == noSlot)
+			{
+				if (!freeSlots.empty())
+				{
+					slots[c] = freeSlots.back();
+					freeSlots.pop_back();
+				}
+				else if (slotCount < slotCapacity || grow_region(slotCapacity * 2)) slots[c] = slotCount++;
+			}
+			// without room in the file the chunk comes back empty, better than memory growing past the budget
+			if (slots[c] != noSlot)
+			{
+				*slot_cells(slots[c]) = cells;
+				stats.writes++;
+			}
+		}
+		freePages.push_back(chunk.page);
+		chunk.page = ParticleChunk::pagedOut;
+		stats.evictions++;
+
+		double ms = ms_since(begin);
+		stats.pageOutMs += ms;
+		stats.maxPageOutMs = std::max(stats.maxPageOutMs, ms);
+	}
+};
\ No newline at end of file
@@ -10,117 +10,44 @@ entt::entity base_particle(entt::registry& reg)
 	return particleEntity;
 }
 
-entt::entity stone(entt::registry& reg)
+// a particle of material with its color and density from the row of materials, moving ones get a ParticleBehavior
+entt::entity particle(entt::registry& reg, ParticleMaterial material)
 {
+	auto& info = material_info(material);
 	auto particleEntity = base_particle(reg);
-	reg.replace<ParticleRenderer>(particleEntity, GRAY);
-	reg.replace<ParticleRigidBody>(particleEntity, 10.f);
+	reg.get<ParticleRenderer>(particleEntity).color = info.color;
+	reg.get<ParticleRigidBody>(particleEntity).density = info.density;
+	if (info.movement != MaterialMovement::none) reg.emplace<ParticleBehavior>(particleEntity).material = material;
 	return particleEntity;
 }
 
-bool canMove(entt::registry& reg, entt::entity particle, int dx, int dy)
-{
-	auto& behavior = reg.get<const ParticleBehavior>(particle);
-	auto& transform = reg.get<ParticleTransform>(particle);
-	auto& rb = reg.get<const ParticleRigidBody>(particle);
+entt::entity stone(entt::registry& reg) { return particle(reg, ParticleMaterial::stone); }
+entt::entity sand(entt::registry& reg) { return particle(reg, ParticleMaterial::sand); }
+entt::entity water(entt::registry& reg) { return particle(reg, ParticleMaterial::water); }
 
-	if (!behavior.grid->InBounds(transform.position.x + dx, transform.position.y + dy)) return false;
-	auto other = behavior.grid->GetParticleAt(transform.position.x + dx, transform.position.y + dy);
-	if (other == entt::null || !reg.valid(other)) return true;
-	return rb.density > reg.get<ParticleRigidBody>(other).density;
-}
-
-entt::entity sand(entt::registry& reg)
+// whether the particle at transform can move dx, dy into a cell that is empty or holds something lighter
+bool canMove(entt::registry& reg, const ParticleGrid& grid, const ParticleTransform& transform, const ParticleRigidBody& rb, int dx, int dy)
 {
-	auto particle = base_particle(reg);
-	reg.get<ParticleRenderer>(particle).color = BEIGE;
-	reg.get<ParticleRigidBody>(particle).density = 2.f;
-	reg.emplace<ParticleBehavior>(particle).onUpdate = [&](auto& reg, auto entity)
-	{
-		int dx = 0;
-		int dy = 0;
-		// if can go straight down
-		if (canMove(reg, entity, 0, 1))
-		{
-			dy = 1;
-		}
-		// if can go in diagonals
-		else if (canMove(reg, entity, -1, 1))
-		{
-			dx = -1;
-			dy = 1;
-		}
-		else if (canMove(reg, entity, 1, 1))
-		{
-			dx = 1;
-			dy = 1;
-		}
-
-
-		auto& transform = reg.get<ParticleTransform>(entity);
-		auto& behavior = reg.get<const ParticleBehavior>(entity);
-		auto other = behavior.grid->GetParticleAt(transform.position.x + dx, transform.position.y + dy);
-		if (other != entt::null && reg.valid(other))
-		{
-			auto& otherTransform = reg.get<ParticleTransform>(other);
-			otherTransform.position.x = transform.position.x;
-			otherTransform.position.y = transform.position.y;
-		}
-		transform.position.x += dx;
-		transform.position.y += dy;
-	};
-	return particle;
+	if (!grid.InBounds(transform.position.x + dx, transform.position.y + dy)) return false;
+	auto other = grid.GetParticleAt(transform.position.x + dx, transform.position.y + dy);
+	if (other == entt::null || !reg.valid(other)) return true;
+	return rb.density > reg.get<const ParticleRigidBody>(other).density;
 }
 
-entt::entity water(entt::registry& reg)
+// swaps the particle with whatever is dx, dy away, in the transforms and in the grid's index
+void moveParticle(entt::registry& reg, ParticleGrid& grid, ParticleTransform& transform, int dx, int dy)
 {
-	auto particle = base_particle(reg);
-	reg.get<ParticleRenderer>(particle).color = BLUE;
-	reg.get<ParticleRigidBody>(particle).density = 1.f;
-	reg.emplace<ParticleBehavior>(particle).onUpdate = [&](auto& reg, auto entity)
+	if (dx == 0 && dy == 0) return;
+	size_t x = transform.position.x;
+	size_t y = transform.position.y;
+	auto other = grid.GetParticleAt(x + dx, y + dy);
+	if (other != entt::null && reg.valid(other))
 	{
-		int dx = 0;
-		int dy = 0;
-		// if can go straight down
-		if (canMove(reg, entity, 0, 1))
-		{
-			dy = 1;
-		}
-		// if can go in diagonals
-		else if (canMove(reg, entity, -1, 1))
-		{
-			dx = -1;
-			dy = 1;
-		}
-		else if (canMove(reg, entity, 1, 1))
-		{
-			dx = 1;
-			dy = 1;
-		}
-		// if can go horizontally
-		else if (canMove(reg, entity, -1, 0))
-		{
-			dx = -1;
-			dy = 0;
-		}
-		else if (canMove(reg, entity, 1, 0))
-		{
-			dx = 1;
-			dy = 0;
-		}
-
-
-		auto& transform = reg.get<ParticleTransform>(entity);
-		auto& behavior = reg.get<const ParticleBehavior>(entity);
-		auto other = behavior.grid->GetParticleAt(transform.position.x, transform.position.y);
-		if (other != entt::null && reg.valid(other))
-		{
-			auto& otherTransform = reg.get<ParticleTransform>(other);
-			otherTransform.position.x = transform.position.x;
-			otherTransform.position.y = transform.position.y;
-		}
-		transform.position.x += dx;
-		transform.position.y += dy;
-	};
-	return particle;
+		auto& otherTransform = reg.get<ParticleTransform>(other);
+		otherTransform.position.x = transform.position.x;
+		otherTransform.position.y = transform.position.y;
+	}
+	grid.Swap(x, y, x + dx, y + dy);
+	transform.position.x += dx;
+	transform.position.y += dy;
 }
\ No newline at end of file
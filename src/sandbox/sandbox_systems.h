@@ -1,11 +1,42 @@
 #pragma once
 #include "sandbox.h"
 
+// moves every entity particle by its material's moves, the first it can make. Reactions, lifetimes and spread
+// need per-cell state and are left to cells storage
 void update_particles(const void*, entt::registry& reg)
 {
-	for (auto&& [entity, behavior] : reg.view<ParticleBehavior>().each())
+	for (auto&& [entity, behavior, transform, rb] : reg.view<const ParticleBehavior, ParticleTransform, const ParticleRigidBody>().each())
 	{
-		behavior.onUpdate(reg, entity);
+		auto& moves = material_moves[(size_t)material_info(behavior.material).movement];
+		for (int i = 0; i < moves.count; i++)
+		{
+			// left first, as the particles always have
+			int dx = -moves.dx[i];
+			if (!canMove(reg, *behavior.grid, transform, rb, dx, moves.dy[i])) continue;
+			moveParticle(reg, *behavior.grid, transform, dx, moves.dy[i]);
+			break;
+		}
+	}
+}
+
+void update_cells(const void*, entt::registry& reg)
+{
+	for (auto&& [entity, grid] : reg.view<ParticleGrid>().each())
+	{
+		if (grid.storage == ParticleStorage::cells) cells::update(grid);
+	}
+}
+
+// moves the active chunks of paged grids to where the camera is looking
+void stream_grids(const void*, entt::registry& reg)
+{
+	for (auto&& [entity, grid, pager, gridRenderer] : reg.view<ParticleGrid, ParticlePager, const ParticleGridRenderer>().each())
+	{
+		fae::profile_zone zone(reg, "ParticlePager::stream");
+		auto region = reg.ctx().find<fae::VisibleRegion>();
+		Vector2 center = region ? Vector2{ region->world.x + region->world.width * 0.5f, region->world.y + region->world.height * 0.5f } : Vector2{ 0, 0 };
+		auto cell = gridRenderer.WorldToGrid(center.x, center.y);
+		pager.stream(grid, (int)std::floor(cell.x), (int)std::floor(cell.y));
 	}
 }
 
@@ -13,37 +44,69 @@ void update_grids(const void*, entt::registry& reg)
 {
 	for (auto&& [entity, grid] : reg.view<ParticleGrid>().each())
 	{
-		// resize grid particle positions if necessary
-		grid.posToParticle.resize(grid.N);
-		for (auto& col : grid.posToParticle)
-		{
-			// clear particle positions
-			col.clear();
-			col.resize(grid.N, entt::null);
-		}
+		if (grid.storage != ParticleStorage::entities) continue;
+		grid.ResizeIndex();
+		if (!grid.verifyIndex) continue;
 
-		// update_controlled_gameobject positions
+		// moves keep the index current, this rebuilds it from the transforms the slow way to check they did
+		std::vector<entt::entity> rebuilt(grid.N * grid.N, (entt::entity)entt::null);
 		for (auto& particle : grid.particles)
 		{
 			if (particle == entt::null || !reg.valid(particle)) continue;
 			auto& transform = reg.get<const ParticleTransform>(particle);
-			grid.posToParticle[transform.position.x][transform.position.y] = particle;
+			rebuilt[(size_t)transform.position.x + (size_t)transform.position.y * grid.N] = particle;
 		}
+		if (rebuilt == grid.posToParticle) continue;
+		TraceLog(LOG_WARNING, "SANDBOX: particle index out of date, rebuilt it");
+		grid.posToParticle = std::move(rebuilt);
 	}
 }
 
-void draw_grids(const void*, entt::registry& reg)
+void rasterize_grids(const void*, entt::registry& reg)
 {
-	for (auto&& [entity, grid, gridRenderer] : reg.view<const ParticleGrid, const ParticleGridRenderer>().each())
+	for (auto&& [entity, grid, gridRenderer] : reg.view<const ParticleGrid, ParticleGridRenderer>().each())
 	{
-		for (auto& particle : grid.particles)
+		// walks the visible cells instead of every particle, so the cost follows what is on screen
+		auto cells = fae::visible_cells(reg, { 0, 0 }, gridRenderer.particleSize, grid.N, grid.N);
+		// a paged grid can be too large for a pixel per cell
+		auto covered = grid.paged ? cells : fae::CellRange{ 0, 0, (int)grid.N, (int)grid.N };
+		gridRenderer.pixelCells = covered;
+		auto& pixels = gridRenderer.pixels;
+		if (pixels.width != covered.Width() || pixels.height != covered.Height()) pixels.Resize(covered.Width(), covered.Height());
+
+		if (grid.storage == ParticleStorage::cells && grid.chunks.size() == grid.ChunksPerSide() * grid.ChunksPerSide())
 		{
-			if (particle == entt::null || !reg.valid(particle)) continue;
-			auto& transform = reg.get<const ParticleTransform>(particle);
-			auto& particleRenderer = reg.get<const ParticleRenderer>(particle);
-			auto screenPos = gridRenderer.GridToScreen(transform.position.x, transform.position.y);
-			DrawRectangle(screenPos.x, screenPos.y, gridRenderer.particleSize, gridRenderer.particleSize, particleRenderer.color);
+			for (int y = cells.yBegin; y < cells.yEnd; y++)
+			{
+				for (int x = cells.xBegin; x < cells.xEnd; x++)
+				{
+					pixels.At(x - covered.xBegin, y - covered.yBegin) = grid.ChunkAt(x, y).Resident() ? cell_color(grid.CellAt(x, y), x, y, grid.updates) : BLANK;
+				}
+			}
+			continue;
+		}
+		for (int y = cells.yBegin; y < cells.yEnd; y++)
+		{
+			for (int x = cells.xBegin; x < cells.xEnd; x++)
+			{
+				auto particle = grid.GetParticleAt(x, y);
+				auto particleRenderer = particle != entt::null && reg.valid(particle) ? reg.try_get<const ParticleRenderer>(particle) : nullptr;
+				pixels.At(x, y) = particleRenderer ? particleRenderer->color : BLANK;
+			}
 		}
+	}
+}
+
+void draw_grids(const void*, entt::registry& reg)
+{
+	for (auto&& [entity, grid, gridRenderer] : reg.view<const ParticleGrid, ParticleGridRenderer>().each())
+	{
+		auto cells = fae::visible_cells(reg, { 0, 0 }, gridRenderer.particleSize, grid.N, grid.N);
+		// only what the last rasterize_grids filled, in the pixels' own coordinates
+		auto covered = gridRenderer.pixelCells;
+		fae::CellRange drawn = { std::max(cells.xBegin, covered.xBegin) - covered.xBegin, std::max(cells.yBegin, covered.yBegin) - covered.yBegin,
+			std::min(cells.xEnd, covered.xEnd) - covered.xBegin, std::min(cells.yEnd, covered.yEnd) - covered.yBegin };
+		fae::draw_pixel_grid(gridRenderer.pixels, gridRenderer.GridToWorld(covered.xBegin, covered.yBegin), gridRenderer.particleSize, drawn);
 
 		if (!gridRenderer.drawDebugGridLines) continue;
 		rlPushMatrix();
@@ -51,15 +114,45 @@ void draw_grids(const void*, entt::registry& reg)
 		rlRotatef(90, 1, 0, 0);
 		DrawGrid(grid.N, gridRenderer.particleSize);
 		rlPopMatrix();
+
+		// what each awake chunk is going through
+		float size = (float)gridRenderer.particleSize;
+		for (uint32_t c : grid.activeChunks)
+		{
+			auto& chunk = grid.chunks[c];
+			if (chunk.Asleep()) continue;
+			DrawRectangleLinesEx({ chunk.dirty.xBegin * size, chunk.dirty.yBegin * size, chunk.dirty.Width() * size, chunk.dirty.Height() * size }, 1, RED);
+		}
 	}
 }
 
 
 
+void cleanup_grids(const void*, entt::registry& reg)
+{
+	for (auto&& [entity, pager] : reg.view<ParticlePager>().each())
+	{
+		auto& stats = pager.stats;
+		TraceLog(LOG_INFO, "SANDBOX: %.1f%% of active chunks resident, %zu paged in (%zu read, avg %.3f ms, max %.3f ms), %zu paged out (%zu written, avg %.3f ms, max %.3f ms)",
+			stats.HitRate() * 100, stats.misses, stats.reads, stats.AvgPageInMs(), stats.maxPageInMs, stats.evictions, stats.writes, stats.AvgPageOutMs(), stats.maxPageOutMs);
+		pager.close();
+	}
+	for (auto&& [entity, gridRenderer] : reg.view<ParticleGridRenderer>().each())
+	{
+		fae::export_headless_snapshot(reg, gridRenderer.pixels);
+		fae::unload_pixel_grid(gridRenderer.pixels);
+	}
+}
+
 void sandbox_plugin(const void*, entt::registry& reg)
 {
-	auto& app = reg.ctx().at<application&>();
-	app.systems.update_controlled_gameobject.emplace<update_particles>();
-	app.systems.update_controlled_gameobject.emplace<update_grids>();
-	app.systems.update_controlled_gameobject.emplace<draw_grids>();
+	auto& app = reg.ctx().at<fae::application&>();
+	// what each system reads and writes, the scheduler only orders the ones that share something
+	app.systems.update_controlled_gameobject.emplace<update_particles, const ParticleBehavior, ParticleTransform, const ParticleRigidBody, ParticleGrid>();
+	app.systems.update_controlled_gameobject.emplace<update_grids, ParticleGrid, const ParticleTransform>();
+	app.systems.update_controlled_gameobject.emplace<stream_grids, ParticleGrid, ParticlePager, const ParticleGridRenderer, const fae::VisibleRegion>();
+	app.systems.update_controlled_gameobject.emplace<update_cells, ParticleGrid>();
+	app.systems.update_controlled_gameobject.emplace<rasterize_grids, const ParticleGrid, ParticleGridRenderer, const ParticleRenderer, const fae::VisibleRegion>();
+	app.systems.render.emplace<draw_grids, const ParticleGrid, ParticleGridRenderer, const fae::VisibleRegion, fae::main_thread>();
+	app.systems.stop.emplace<cleanup_grids, ParticlePager, ParticleGridRenderer, fae::main_thread>();
 }
\ No newline at end of file